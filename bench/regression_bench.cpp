@@ -0,0 +1,262 @@
+#include <lg/parser.h>
+
+#include "llvm_ir_gen.h"
+
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/FormatVariadic.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/TargetParser/Host.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Compiles every lg program in the program directory at each optimization level, runs the binaries and
+// compares compile time, run time and binary size against a JSON baseline.
+//
+//   lg_regression_bench [--programs dir] [--baseline file] [--output file] [--update]
+//                       [--threshold percent] [--compile-threshold percent] [--runs count]
+//                       [--opt-levels 0,1,2,3]
+//
+// Compile and run times are the best of --runs attempts; compile time covers parsing, generation,
+// optimization and linking. --update writes the measurements to the baseline instead of comparing, and a
+// missing baseline only records the results. The exit status is 1 when run time or binary size is more than
+// threshold percent, or compile time more than compile-threshold percent, worse than its baseline.
+
+namespace
+{
+    struct BenchOptions
+    {
+        std::string programs = LG_BENCH_PROGRAM_DIR;
+        std::string baseline = "bench_baseline.json";
+        std::string output = "bench_results.json";
+        bool update = false;
+        double threshold = 10;
+        // Compile time also covers linking and is noisier than run time.
+        double compileThreshold = 25;
+        unsigned runs = 3;
+        std::vector<unsigned> optLevels = {0, 1, 2, 3};
+    };
+
+    struct Measurement
+    {
+        double compileMs = 0;
+        double runMs = 0;
+        uint64_t binaryBytes = 0;
+    };
+
+    double millisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    BenchOptions parseArguments(int argc, char** argv)
+    {
+        BenchOptions options;
+        const std::vector<std::string> args(argv + 1, argv + argc);
+        for (size_t i = 0; i < args.size(); ++i)
+        {
+            const auto value = [&]() -> const std::string&
+            {
+                if (i + 1 >= args.size()) throw std::runtime_error(args[i] + " expects a value");
+                return args[++i];
+            };
+            if (args[i] == "--programs") options.programs = value();
+            else if (args[i] == "--baseline") options.baseline = value();
+            else if (args[i] == "--output") options.output = value();
+            else if (args[i] == "--update") options.update = true;
+            else if (args[i] == "--threshold") options.threshold = std::stod(value());
+            else if (args[i] == "--compile-threshold") options.compileThreshold = std::stod(value());
+            else if (args[i] == "--runs") options.runs = std::max(std::stoul(value()), 1ul);
+            else if (args[i] == "--opt-levels")
+            {
+                llvm::SmallVector<llvm::StringRef> levels;
+                llvm::StringRef(value()).split(levels, ',', -1, false);
+                options.optLevels.clear();
+                for (const auto level : levels) options.optLevels.push_back(std::stoul(level.str()));
+            }
+            else throw std::runtime_error("unknown argument " + args[i]);
+        }
+        return options;
+    }
+
+    std::vector<std::string> findPrograms(const std::string& directory)
+    {
+        std::vector<std::string> programs;
+        std::error_code error;
+        for (llvm::sys::fs::directory_iterator it(directory, error), end; it != end && !error; it.increment(error))
+            if (llvm::sys::path::extension(it->path()) == ".lg") programs.push_back(it->path());
+        if (error) throw std::runtime_error("Failed to list " + directory + ": " + error.message());
+        std::ranges::sort(programs);
+        return programs;
+    }
+
+    Measurement measure(const std::string& program, unsigned optLevel, const std::string& binary, unsigned runs)
+    {
+        auto buffer = llvm::MemoryBuffer::getFile(program);
+        if (!buffer) throw std::runtime_error("Failed to read " + program + ": " + buffer.getError().message());
+        Measurement measurement;
+
+        // The fastest of several attempts is the least noisy estimate of both the compiler's and the code's
+        // own cost.
+        for (unsigned run = 0; run < runs; ++run)
+        {
+            const auto compileStart = std::chrono::steady_clock::now();
+            const auto module = lg::ir::parser::parse((*buffer)->getBuffer().str());
+            llvm::LLVMContext context;
+            llvm::Module llvmModule(llvm::sys::path::stem(program), context);
+            lg::llvm_ir_gen::CompileOptions compileOptions;
+            compileOptions.triple = llvm::sys::getDefaultTargetTriple();
+            compileOptions.optLevel = optLevel;
+            lg::llvm_ir_gen::configureModule(&llvmModule, compileOptions);
+            lg::llvm_ir_gen::LLVMIRGenerator generator(module, &context, &llvmModule);
+            generator.generate();
+            lg::llvm_ir_gen::compile(&llvmModule, compileOptions, binary);
+            const auto time = millisecondsSince(compileStart);
+            measurement.compileMs = run == 0 ? time : std::min(measurement.compileMs, time);
+        }
+
+        uint64_t size;
+        if (const auto error = llvm::sys::fs::file_size(binary, size))
+            throw std::runtime_error("Failed to stat " + binary + ": " + error.message());
+        measurement.binaryBytes = size;
+
+        const std::optional<llvm::StringRef> redirects[] = {std::nullopt, llvm::StringRef(""), std::nullopt};
+        for (unsigned run = 0; run < runs; ++run)
+        {
+            std::string error;
+            const auto runStart = std::chrono::steady_clock::now();
+            const auto status = llvm::sys::ExecuteAndWait(binary, {binary}, std::nullopt, redirects, 0, 0, &error);
+            const auto time = millisecondsSince(runStart);
+            if (status != 0)
+                throw std::runtime_error(binary + " exited with status " + std::to_string(status) + " " + error);
+            measurement.runMs = run == 0 ? time : std::min(measurement.runMs, time);
+        }
+        return measurement;
+    }
+
+    llvm::json::Value toJSON(const std::map<std::string, Measurement>& results)
+    {
+        llvm::json::Object benchmarks;
+        for (const auto& [name, measurement] : results)
+        {
+            benchmarks[name] = llvm::json::Object{
+                {"compile_ms", measurement.compileMs},
+                {"run_ms", measurement.runMs},
+                {"binary_bytes", static_cast<int64_t>(measurement.binaryBytes)},
+            };
+        }
+        return llvm::json::Object{{"version", 1}, {"benchmarks", std::move(benchmarks)}};
+    }
+
+    void writeJSON(const std::string& path, llvm::json::Value value)
+    {
+        std::error_code error;
+        llvm::raw_fd_ostream out(path, error, llvm::sys::fs::OF_Text);
+        if (error) throw std::runtime_error("Failed to open " + path + ": " + error.message());
+        out << llvm::formatv("{0:2}", value) << "\n";
+    }
+
+    std::map<std::string, Measurement> readBaseline(const std::string& path)
+    {
+        auto buffer = llvm::MemoryBuffer::getFile(path);
+        if (!buffer) throw std::runtime_error("Failed to read " + path + ": " + buffer.getError().message());
+        auto value = llvm::json::parse((*buffer)->getBuffer());
+        if (!value) throw std::runtime_error("Malformed baseline " + path + ": " + llvm::toString(value.takeError()));
+        const auto* benchmarks = value->getAsObject() ? value->getAsObject()->getObject("benchmarks") : nullptr;
+        if (benchmarks == nullptr) throw std::runtime_error("Baseline " + path + " has no benchmarks");
+        std::map<std::string, Measurement> results;
+        for (const auto& [name, entry] : *benchmarks)
+        {
+            const auto* object = entry.getAsObject();
+            if (object == nullptr) continue;
+            results[name.str()] = {
+                object->getNumber("compile_ms").value_or(0),
+                object->getNumber("run_ms").value_or(0),
+                static_cast<uint64_t>(object->getInteger("binary_bytes").value_or(0)),
+            };
+        }
+        return results;
+    }
+
+    // Prints one line per metric and returns whether it regressed.
+    bool compare(const std::string& name, const char* metric, double baseline, double current, double threshold)
+    {
+        const auto change = baseline > 0 ? (current - baseline) / baseline * 100 : 0;
+        const bool regressed = change > threshold;
+        llvm::outs() << llvm::formatv("{0,-32} {1,-12} {2,12:F2} {3,12:F2} {4,+8:F1}%{5}\n", name, metric, baseline,
+                                      current, change, regressed ? "  REGRESSION" : "");
+        return regressed;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        const auto options = parseArguments(argc, argv);
+        llvm::SmallString<128> workDirectory;
+        if (const auto error = llvm::sys::fs::createUniqueDirectory("lg-bench", workDirectory))
+            throw std::runtime_error("Failed to create a work directory: " + error.message());
+
+        std::map<std::string, Measurement> results;
+        for (const auto& program : findPrograms(options.programs))
+        {
+            for (const auto optLevel : options.optLevels)
+            {
+                const auto name = llvm::sys::path::stem(program).str() + ".O" + std::to_string(optLevel);
+                llvm::SmallString<128> binary(workDirectory);
+                llvm::sys::path::append(binary, name);
+                std::cout << "running " << name << std::endl;
+                results[name] = measure(program, optLevel, binary.str().str(), options.runs);
+            }
+        }
+        llvm::sys::fs::remove_directories(workDirectory);
+
+        writeJSON(options.output, toJSON(results));
+        if (options.update)
+        {
+            writeJSON(options.baseline, toJSON(results));
+            std::cout << "baseline written to " << options.baseline << std::endl;
+            return 0;
+        }
+
+        if (!llvm::sys::fs::exists(options.baseline))
+        {
+            std::cout << "no baseline at " << options.baseline << ", results recorded in " << options.output
+                << "; run with --update to create one" << std::endl;
+            return 0;
+        }
+        const auto baseline = readBaseline(options.baseline);
+        bool regressed = false;
+        for (const auto& [name, current] : results)
+        {
+            const auto it = baseline.find(name);
+            if (it == baseline.end())
+            {
+                llvm::outs() << name << ": no baseline\n";
+                continue;
+            }
+            regressed |= compare(name, "compile_ms", it->second.compileMs, current.compileMs,
+                                 options.compileThreshold);
+            regressed |= compare(name, "run_ms", it->second.runMs, current.runMs, options.threshold);
+            regressed |= compare(name, "binary_bytes", static_cast<double>(it->second.binaryBytes),
+                                 static_cast<double>(current.binaryBytes), options.threshold);
+        }
+        return regressed ? 1 : 0;
+    }
+    catch (const std::exception& e)
+    {
+        llvm::errs() << "lg_regression_bench: " << e.what() << "\n";
+        return 2;
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef LG_LLVM_IR_GENERATOR_CPP_ASYNC_COMPILE_H
+#define LG_LLVM_IR_GENERATOR_CPP_ASYNC_COMPILE_H
+#include <lg/ir.h>
+
+#include "codegen.h"
+#include "llvm_ir_gen.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace lg::llvm_ir_gen
+{
+    enum class CompileStage
+    {
+        GENERATE,
+        OPTIMIZE,
+        EMIT,
+        LINK
+    };
+
+    const char* toString(CompileStage stage);
+
+    struct CompileProgress
+    {
+        CompileStage stage;
+        // Functions generated or passes started so far in this stage; total is 0 when not known up front.
+        size_t completed = 0;
+        size_t total = 0;
+        // The function just generated or the pass about to run, empty at the start of a stage.
+        std::string item;
+    };
+
+    class CompileCancelled : public std::runtime_error
+    {
+    public:
+        CompileCancelled();
+    };
+
+    // Shared between the caller and a running compile; copies observe the same flag. Cancellation is
+    // cooperative: it is checked between functions while generating, between passes while optimizing and
+    // between stages.
+    class CancellationToken
+    {
+    private:
+        std::shared_ptr<std::atomic<bool>> cancelled = std::make_shared<std::atomic<bool>>(false);
+
+    public:
+        void cancel() const;
+
+        bool isCancelled() const;
+
+        void throwIfCancelled() const;
+    };
+
+    struct AsyncCompileOptions
+    {
+        CompileOptions compile;
+        GeneratorOptions generator;
+        // Called from executor threads, never concurrently for the same compile.
+        std::function<void(const CompileProgress&)> onProgress;
+        CancellationToken cancellation;
+    };
+
+    // A fixed pool of threads running compile stages. Each stage of a compile is queued as its own task once the
+    // previous stage finishes, so independent compiles overlap: one module can be linking while another is
+    // still being optimized.
+    class CompileExecutor
+    {
+    private:
+        std::mutex queueMutex;
+        std::condition_variable queueCondition;
+        std::deque<std::function<void()>> queue;
+        bool stopping = false;
+        std::vector<std::thread> workers;
+
+        void runWorker();
+
+    public:
+        explicit CompileExecutor(unsigned threads = std::thread::hardware_concurrency());
+
+        // Runs every queued stage, including the ones they queue in turn, before joining the workers.
+        ~CompileExecutor();
+
+        CompileExecutor(const CompileExecutor&) = delete;
+        CompileExecutor& operator=(const CompileExecutor&) = delete;
+
+        void submit(std::function<void()> task);
+    };
+
+    // Generates, optimizes, emits and links module into output on the executor. The future carries any
+    // error, including CompileCancelled. module must stay alive until the future is ready.
+    std::future<void> compileAsync(CompileExecutor& executor, ir::IRModule* module, std::string output,
+                                   AsyncCompileOptions options);
+}
+
+#endif //LG_LLVM_IR_GENERATOR_CPP_ASYNC_COMPILE_H
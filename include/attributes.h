@@ -0,0 +1,22 @@
+#ifndef LG_LLVM_IR_GENERATOR_CPP_ATTRIBUTES_H
+#define LG_LLVM_IR_GENERATOR_CPP_ATTRIBUTES_H
+#include <string>
+#include <vector>
+
+namespace lg::llvm_ir_gen
+{
+    // An lg attribute string of the form `name` or `name(argument, ...)`.
+    struct Attribute
+    {
+        std::string name;
+        std::vector<std::string> arguments;
+    };
+
+    Attribute parseAttribute(const std::string& text);
+
+    std::vector<Attribute> findAttributes(const std::vector<std::string>& attributes, const std::string& name);
+
+    bool hasAttribute(const std::vector<std::string>& attributes, const std::string& name);
+}
+
+#endif //LG_LLVM_IR_GENERATOR_CPP_ATTRIBUTES_H
@@ -0,0 +1,97 @@
+#ifndef LG_LLVM_IR_GENERATOR_CPP_BINARY_IR_H
+#define LG_LLVM_IR_GENERATOR_CPP_BINARY_IR_H
+#include <lg/ir.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lg::llvm_ir_gen
+{
+    // Layout of a binary lg IR file (all integers little endian, counts and indices ULEB128):
+    //   header   "LGIRBIN\0", u32 version, u32 section count, then {u32 kind, u64 offset, u64 size} per section
+    //   STRINGS     interned strings, referenced by index everywhere else
+    //   STRUCTURES  name and attributes of every structure
+    //   TYPES       deduplicated types; element types refer to earlier entries, structure types to STRUCTURES
+    //   FIELDS      field names and types per structure
+    //   FUNCTIONS   signature, arguments, locals and the offset and size of the body inside BODIES
+    //   GLOBALS     declaration and initializer of every global
+    //   BODIES      per function: registers, block names and instructions, decoded only on demand
+    constexpr char BINARY_IR_MAGIC[8] = {'L', 'G', 'I', 'R', 'B', 'I', 'N', '\0'};
+    constexpr uint32_t BINARY_IR_VERSION = 1;
+
+    enum class BinaryIRSection : uint32_t
+    {
+        STRINGS,
+        STRUCTURES,
+        TYPES,
+        FIELDS,
+        FUNCTIONS,
+        GLOBALS,
+        BODIES
+    };
+
+    void writeBinaryModule(ir::IRModule* module, llvm::SmallVectorImpl<char>& output);
+
+    void writeBinaryModule(ir::IRModule* module, const std::string& path);
+
+    // Parses textual lg IR and writes it in the binary format.
+    void convertTextToBinary(const std::string& code, const std::string& path);
+
+    // A binary lg IR file mapped into memory. Structures, globals and function signatures are decoded up front;
+    // function bodies stay encoded until loadFunction or loadAllFunctions asks for them. Until then a defined
+    // function has an empty CFG, so generate either after loadAllFunctions or with
+    // GeneratorOptions::loadFunctionBody calling loadFunction.
+    class BinaryIRModule
+    {
+    private:
+        struct FunctionEntry
+        {
+            ir::function::IRFunction* function;
+            std::vector<ir::function::IRLocalVariable*> variables;
+            uint64_t bodyOffset;
+            uint64_t bodySize;
+            bool loaded;
+        };
+
+        std::unique_ptr<llvm::MemoryBuffer> buffer;
+        std::unordered_map<BinaryIRSection, llvm::StringRef> sections;
+        std::vector<llvm::StringRef> strings;
+        std::vector<ir::type::IRType*> types;
+        std::vector<ir::structure::IRStructure*> structures;
+        std::vector<ir::base::IRGlobalVariable*> globals;
+        std::vector<FunctionEntry> functions;
+        // The functions in file order, which is how bodies and initializers refer to them.
+        std::vector<ir::function::IRFunction*> functionTable;
+        std::unordered_map<ir::function::IRFunction*, size_t> functionIndices;
+        ir::IRModule* module;
+
+        llvm::StringRef getSection(BinaryIRSection kind) const;
+        void readHeader();
+        void readStrings();
+        void readStructures();
+        void readTypes();
+        void readFields();
+        void readFunctions();
+        void readGlobals();
+        void loadFunction(FunctionEntry& entry);
+
+    public:
+        explicit BinaryIRModule(const std::string& path);
+
+        BinaryIRModule(const BinaryIRModule&) = delete;
+        BinaryIRModule& operator=(const BinaryIRModule&) = delete;
+
+        ir::IRModule* getModule() const;
+
+        void loadFunction(ir::function::IRFunction* function);
+
+        void loadAllFunctions();
+    };
+}
+
+#endif //LG_LLVM_IR_GENERATOR_CPP_BINARY_IR_H
@@ -0,0 +1,97 @@
+#ifndef LG_LLVM_IR_GENERATOR_CPP_CODEGEN_H
+#define LG_LLVM_IR_GENERATOR_CPP_CODEGEN_H
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Passes/OptimizationLevel.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include "linker.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lg::llvm_ir_gen
+{
+    enum class PGOMode
+    {
+        NONE,
+        INSTRUMENT,
+        USE
+    };
+
+    struct CompileOptions
+    {
+        std::string triple;
+        // "native" selects the host CPU and its features.
+        std::string cpu;
+        // Comma-separated feature list such as "+avx2,+fma", added to the CPU's own features.
+        std::string features;
+        LinkerKind linker = LinkerKind::CLANG;
+        unsigned optLevel = 0;
+        PGOMode pgo = PGOMode::NONE;
+        // INSTRUMENT: where the binary writes its .profraw at exit (empty means default.profraw).
+        // USE: the merged .profdata to optimize with.
+        std::string profilePath;
+        // Optimization remarks from the optimizer and codegen are written here when non-empty.
+        std::string remarksFile;
+        // "yaml" or "bitstream".
+        std::string remarksFormat = "yaml";
+        // Regular expression over pass names; empty keeps every pass.
+        std::string remarksFilter;
+        // Summary of missed vectorizations and inlining failures, "-" for stdout.
+        std::string remarksSummary;
+        // Size profile: -Oz, function and data sections, non-exported symbols internalized and constants made
+        // mergeable, and a --gc-sections --icf=all link.
+        bool optimizeForSize = false;
+        // Symbols the size profile keeps externally visible.
+        std::vector<std::string> exportedSymbols = {"main"};
+        // Per-function size breakdown of the linked binary, "-" for stdout.
+        std::string sizeReport;
+        // Consulted before every optional optimization pass; returning false skips the pass.
+        std::function<bool(llvm::StringRef pass)> shouldRunPass;
+    };
+
+    void initializeTargets();
+
+    llvm::OptimizationLevel toOptimizationLevel(unsigned optLevel);
+
+    std::unique_ptr<llvm::TargetMachine> createTargetMachine(const std::string& triple, const std::string& cpu,
+                                                             const std::string& features, unsigned optLevel);
+
+    std::string resolveCPU(const std::string& cpu);
+
+    std::string resolveFeatures(const std::string& cpu, const std::string& features);
+
+    // The CPU and features resolved from CompileOptions, as recorded on a module by configureModule.
+    struct ModuleTarget
+    {
+        std::string cpu;
+        std::string features;
+    };
+
+    // Sets the module's triple and data layout and records the resolved CPU and features, which the generator
+    // stamps on every defined function.
+    void configureModule(llvm::Module* module, const CompileOptions& options);
+
+    // Empty for a module that configureModule has not seen.
+    ModuleTarget getModuleTarget(const llvm::Module* module);
+
+    // Sets the module's triple and data layout, applies the size profile if requested and returns the
+    // target machine the remaining stages use.
+    std::unique_ptr<llvm::TargetMachine> prepareModule(llvm::Module* module, const CompileOptions& options);
+
+    std::vector<std::string> definedFunctionNames(const llvm::Module* module);
+
+    LinkOptions toLinkOptions(const CompileOptions& options);
+
+    void applySizeProfile(llvm::Module* module, llvm::TargetMachine* targetMachine,
+                          const std::vector<std::string>& exportedSymbols);
+
+    void optimize(llvm::Module* module, llvm::TargetMachine* targetMachine, const CompileOptions& options);
+
+    void emitObject(llvm::Module* module, llvm::TargetMachine* targetMachine, llvm::SmallVectorImpl<char>& object);
+}
+
+#endif //LG_LLVM_IR_GENERATOR_CPP_CODEGEN_H
@@ -0,0 +1,58 @@
+#ifndef LG_LLVM_IR_GENERATOR_CPP_IR_CONSTRUCTION_H
+#define LG_LLVM_IR_GENERATOR_CPP_IR_CONSTRUCTION_H
+#include <lg/ir.h>
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace lg::llvm_ir_gen
+{
+    // Building lg IR outside the lg parser (the binary IR loader and the benchmarks) goes through these helpers.
+    // ir_construction.cpp also asserts the signature of every constructor the loader calls directly, so a
+    // mismatch with lg-cpp is reported there first.
+    namespace construction
+    {
+        using Type = std::remove_pointer_t<decltype(ir::type::IRPointerType::base)>;
+        using Register = std::remove_pointer_t<decltype(ir::instruction::IRLoad::target)>;
+        using Field = std::remove_pointer_t<decltype(ir::structure::IRStructure::fields)::value_type>;
+        using ControlFlowGraph = std::remove_pointer_t<decltype(ir::function::IRFunction::cfg)>;
+    }
+
+    ir::IRModule* makeModule();
+
+    ir::structure::IRStructure* makeStructure(std::vector<std::string> attributes, std::string name);
+
+    construction::Field* makeField(construction::Type* type, std::string name);
+
+    ir::base::IRGlobalVariable* makeGlobalVariable(std::vector<std::string> attributes, bool isConstant,
+                                                   std::string name, construction::Type* type);
+
+    ir::function::IRLocalVariable* makeLocalVariable(construction::Type* type, std::string name);
+
+    ir::function::IRFunction* makeFunction(std::vector<std::string> attributes, construction::Type* returnType,
+                                           std::string name, std::vector<ir::function::IRLocalVariable*> args,
+                                           bool isVarArg, bool isExtern);
+
+    ir::base::IRBasicBlock* makeBasicBlock(construction::ControlFlowGraph* cfg, std::string name);
+
+    construction::Register* makeRegister(std::string name, construction::Type* type);
+
+    ir::type::IRIntegerType* makeIntegerType(uint64_t size, bool isUnsigned);
+
+    ir::type::IRArrayType* makeArrayType(construction::Type* base, uint64_t size);
+
+    ir::value::constant::IRIntegerConstant* makeIntegerConstant(ir::type::IRIntegerType* type, int64_t value);
+
+    ir::value::constant::IRArrayConstant* makeArrayConstant(
+        ir::type::IRArrayType* type, decltype(ir::value::constant::IRArrayConstant::elements) elements);
+
+    void addStructure(ir::IRModule* module, ir::structure::IRStructure* structure);
+
+    void addFunction(ir::IRModule* module, ir::function::IRFunction* function);
+
+    void addGlobalVariable(ir::IRModule* module, ir::base::IRGlobalVariable* global);
+}
+
+#endif //LG_LLVM_IR_GENERATOR_CPP_IR_CONSTRUCTION_H
@@ -0,0 +1,51 @@
+#ifndef LG_LLVM_IR_GENERATOR_CPP_LAYOUT_H
+#define LG_LLVM_IR_GENERATOR_CPP_LAYOUT_H
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/DerivedTypes.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lg::llvm_ir_gen
+{
+    constexpr uint64_t CACHE_LINE_SIZE = 64;
+
+    struct FieldLayout
+    {
+        std::string name;
+        std::string type;
+        uint64_t offset;
+        uint64_t size;
+        uint64_t alignment;
+        bool hot;
+        bool crossesCacheLine;
+    };
+
+    struct StructureLayout
+    {
+        std::string name;
+        uint64_t size;
+        uint64_t alignment;
+        uint64_t padding;
+        bool packed;
+        // Set when the fields were emitted in suggestedOrder instead of declaration order.
+        bool reordered;
+        std::vector<FieldLayout> fields;
+        // Indices into fields; equal to the identity when the current order is already best.
+        std::vector<unsigned> suggestedOrder;
+        uint64_t suggestedSize;
+    };
+
+    // Hot fields first so they share the leading cache lines, then by alignment and size, both descending.
+    std::vector<unsigned> suggestFieldOrder(const llvm::DataLayout& dataLayout, const std::vector<llvm::Type*>& fields,
+                                            const std::vector<bool>& hot);
+
+    StructureLayout analyzeStructure(const llvm::DataLayout& dataLayout, llvm::StructType* structType,
+                                     const std::vector<std::string>& fieldNames, const std::vector<bool>& hot);
+
+    void printLayoutReport(llvm::raw_ostream& out, const std::vector<StructureLayout>& layouts);
+}
+
+#endif //LG_LLVM_IR_GENERATOR_CPP_LAYOUT_H
@@ -0,0 +1,31 @@
+#ifndef LG_LLVM_IR_GENERATOR_CPP_LINKER_H
+#define LG_LLVM_IR_GENERATOR_CPP_LINKER_H
+#include <llvm/ADT/StringRef.h>
+
+#include <string>
+#include <vector>
+
+namespace lg::llvm_ir_gen
+{
+    enum class LinkerKind
+    {
+        CLANG,
+        LLD
+    };
+
+    struct LinkOptions
+    {
+        LinkerKind linker = LinkerKind::CLANG;
+        std::string triple;
+        // Links the compiler-rt profile runtime needed by PGO-instrumented objects.
+        bool profileRuntime = false;
+        // Drops unreferenced sections and folds identical functions; folding needs lld.
+        bool optimizeForSize = false;
+    };
+
+    bool runClangDriver(const std::vector<std::string>& inputs, const std::string& triple, const std::string& output);
+
+    void linkObjects(const std::vector<llvm::StringRef>& objects, const LinkOptions& options, const std::string& output);
+}
+
+#endif //LG_LLVM_IR_GENERATOR_CPP_LINKER_H
@@ -30,14 +30,81 @@
 #include <clang/Basic/DiagnosticIDs.h>
 #include <llvm/Support/VirtualFileSystem.h>
 
+#include <functional>
 #include <stack>
+#include <type_traits>
+
+#include "attributes.h"
+#include "codegen.h"
+#include "layout.h"
 
 namespace lg::llvm_ir_gen
 {
+    enum class CounterMode
+    {
+        NONE,
+        FUNCTION,
+        BASIC_BLOCK
+    };
+
+    // Set on every target_clones variant to the features that variant adds on top of the module's own, so a
+    // retargeted copy of the module can rebuild its target-features.
+    constexpr char CLONE_FEATURES_ATTRIBUTE[] = "lg-clone-features";
+
+    struct GeneratorOptions
+    {
+        // Emits relaxed atomic execution counters and a dump hook that writes them on exit, or at the next
+        // instrumented function entry after SIGUSR1.
+        CounterMode counters = CounterMode::NONE;
+        // Emits structures marked `reorderable` in the suggested field order; see getStructureLayouts.
+        bool reorderStructures = false;
+        // Called before a defined function is lowered so its body can be materialized on demand, e.g. with
+        // BinaryIRModule::loadFunction. Without it every body must already be loaded.
+        std::function<void(ir::function::IRFunction*)> loadFunctionBody;
+        // Called after each function body is generated; throwing from it abandons generation.
+        std::function<void(ir::function::IRFunction*)> onFunctionGenerated;
+    };
+
+    enum class TypeKind
+    {
+        SIGNED_INTEGER,
+        UNSIGNED_INTEGER,
+        FLOAT,
+        DOUBLE,
+        POINTER,
+        AGGREGATE,
+        FUNCTION,
+        VOID
+    };
+
+    // What instruction lowering needs to know about an lg type.
+    struct TypeInfo
+    {
+        TypeKind kind;
+        llvm::Type* llvmType;
+        // Pointee of a pointer type.
+        ir::type::IRType* base = nullptr;
+
+        bool isInteger() const
+        {
+            return kind == TypeKind::SIGNED_INTEGER || kind == TypeKind::UNSIGNED_INTEGER;
+        }
+
+        bool isFloatingPoint() const
+        {
+            return kind == TypeKind::FLOAT || kind == TypeKind::DOUBLE;
+        }
+    };
+
     class LLVMIRGenerator final : public ir::IRVisitor
     {
     private:
+        using IRType = ir::type::IRType;
+        using IROperand = std::remove_pointer_t<decltype(ir::instruction::IRStore::value)>;
+        using IRInstruction = std::remove_pointer_t<decltype(ir::base::IRBasicBlock::instructions)::value_type>;
+
         ir::IRModule* module;
+        GeneratorOptions options;
         llvm::LLVMContext* context;
         llvm::Module* llvmModule;
         llvm::IRBuilder<>* builder;
@@ -48,11 +115,42 @@ namespace lg::llvm_ir_gen
         std::unordered_map<ir::base::IRBasicBlock*, llvm::BasicBlock*> irBlock2LLVMBlock;
         std::unordered_map<ir::function::IRLocalVariable*, llvm::Value*> irLocalVariable2Value;
         std::unordered_map<ir::value::IRRegister*, llvm::Value*> register2Value;
+        std::unordered_map<llvm::BasicBlock*, uint32_t> blockBranchWeights;
+        // Aggregate loads replaced by a memcpy; erased at the end of the function unless a later use turned up.
+        std::vector<llvm::LoadInst*> copiedAggregateLoads;
+        std::unordered_map<llvm::BasicBlock*, llvm::MDNode*> loopMetadata;
+        std::unordered_map<std::string, llvm::CallInst::TailCallKind> tailCallKinds;
+        // Declaration index to emitted index for every reordered structure.
+        std::unordered_map<llvm::StructType*, std::vector<unsigned>> structureFieldPositions;
+        std::vector<StructureLayout> structureLayouts;
+        std::vector<std::pair<std::string, llvm::GlobalVariable*>> counters;
+
+        TypeInfo classifyType(IRType* type);
+        llvm::Type* lowerType(IRType* type);
+        llvm::Value* lowerOperand(IROperand* value);
+        void lowerInstruction(IRInstruction* instruction, const std::any& additional);
+        void applyFunctionAttributes(ir::function::IRFunction* irFunction, llvm::Function* llvmFunction);
+        llvm::BasicBlock* findHintBlock(ir::function::IRFunction* irFunction, const Attribute& attribute);
+        void collectBranchHints(ir::function::IRFunction* irFunction);
+        void collectLoopHints(ir::function::IRFunction* irFunction);
+        void attachLoopMetadata(llvm::Instruction* branch);
+        void collectTailCallHints(ir::function::IRFunction* irFunction);
+        void applyTailCallHints(ir::function::IRFunction* irFunction);
+        llvm::Function* getCEntryPoint(llvm::Function* function);
+        llvm::MDNode* createBranchWeights(const std::vector<llvm::BasicBlock*>& successors);
+        llvm::Value* lowerBuiltin(ir::function::IRFunction* irFunction, const std::vector<llvm::Value*>& args);
+        void emitCounterIncrement(const std::string& name);
+        void emitCounterDumpCheck(llvm::BasicBlock* next);
+        void emitCounterRuntime();
+        void emitMultiversionedFunctions();
+        void ensureStructureBody(llvm::Type* type);
 
     public:
-        LLVMIRGenerator(ir::IRModule* module, llvm::LLVMContext* context, llvm::Module* llvmModule);
+        LLVMIRGenerator(ir::IRModule* module, llvm::LLVMContext* context, llvm::Module* llvmModule,
+                        GeneratorOptions options = {});
         ~LLVMIRGenerator() override;
         std::string generate();
+        const std::vector<StructureLayout>& getStructureLayouts() const;
 
         std::any visitModule(ir::IRModule* module, std::any additional) override;
         std::any visitGlobalVariable(ir::base::IRGlobalVariable* irGlobalVariable, std::any additional) override;
@@ -108,6 +206,7 @@ namespace lg::llvm_ir_gen
                                             std::any additional) override;
     };
 
+    void compile(llvm::Module* module, const CompileOptions& options, std::string output);
     void compile(llvm::Module* module, std::string triple, std::string output);
 }
 
@@ -0,0 +1,43 @@
+#ifndef LG_LLVM_IR_GENERATOR_CPP_MULTI_TARGET_H
+#define LG_LLVM_IR_GENERATOR_CPP_MULTI_TARGET_H
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/Module.h>
+
+#include "codegen.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace lg::llvm_ir_gen
+{
+    struct TargetSpec
+    {
+        std::string triple;
+        // Same meaning as in CompileOptions.
+        std::string cpu;
+        std::string features;
+        // Where compileForTargets links this target's binary.
+        std::string output;
+    };
+
+    struct TargetObject
+    {
+        TargetSpec target;
+        llvm::SmallVector<char, 0> object;
+        std::chrono::milliseconds time{0};
+    };
+
+    // Optimizes and emits one object per target from a single generated module, each target on its own
+    // thread in its own context. Every function is given the target's CPU and features in place of those it
+    // was generated with; only the features of target_clones variants are kept, and such modules are rejected
+    // for non-x86 targets. The data layout's type sizes must be shared by the targets, since copies of
+    // aggregates are sized at generation time. Remarks and size reports in options are ignored here.
+    std::vector<TargetObject> emitForTargets(const llvm::Module* module, const std::vector<TargetSpec>& targets,
+                                             const CompileOptions& options);
+
+    void compileForTargets(const llvm::Module* module, const std::vector<TargetSpec>& targets,
+                           const CompileOptions& options);
+}
+
+#endif //LG_LLVM_IR_GENERATOR_CPP_MULTI_TARGET_H
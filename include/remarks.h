@@ -0,0 +1,61 @@
+#ifndef LG_LLVM_IR_GENERATOR_CPP_REMARKS_H
+#define LG_LLVM_IR_GENERATOR_CPP_REMARKS_H
+#include <llvm/IR/DiagnosticHandler.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/Support/ToolOutputFile.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "codegen.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lg::llvm_ir_gen
+{
+    struct Remark
+    {
+        enum class Kind
+        {
+            PASSED,
+            MISSED,
+            ANALYSIS
+        };
+
+        Kind kind;
+        std::string pass;
+        std::string name;
+        // The lg function and basic block the remark refers to; the block is empty for function-level remarks.
+        std::string function;
+        std::string block;
+        std::string message;
+    };
+
+    // Enables optimization remarks on a context until destroyed. Remarks are streamed to
+    // CompileOptions::remarksFile and also collected so finish() can write the summary.
+    class RemarkSession
+    {
+    private:
+        llvm::LLVMContext& context;
+        std::unique_ptr<llvm::DiagnosticHandler> previousHandler;
+        std::unique_ptr<llvm::ToolOutputFile> output;
+        std::string summaryPath;
+        std::shared_ptr<std::vector<Remark>> remarks;
+
+    public:
+        RemarkSession(llvm::LLVMContext& context, const CompileOptions& options);
+
+        ~RemarkSession();
+
+        RemarkSession(const RemarkSession&) = delete;
+        RemarkSession& operator=(const RemarkSession&) = delete;
+
+        const std::vector<Remark>& getRemarks() const;
+
+        void writeSummary(llvm::raw_ostream& out) const;
+
+        void finish();
+    };
+}
+
+#endif //LG_LLVM_IR_GENERATOR_CPP_REMARKS_H
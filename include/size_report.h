@@ -0,0 +1,30 @@
+#ifndef LG_LLVM_IR_GENERATOR_CPP_SIZE_REPORT_H
+#define LG_LLVM_IR_GENERATOR_CPP_SIZE_REPORT_H
+#include <llvm/Support/raw_ostream.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace lg::llvm_ir_gen
+{
+    struct FunctionSize
+    {
+        std::string name;
+        // Empty when the function was inlined everywhere or dropped by --gc-sections.
+        std::optional<uint64_t> size;
+        // The function whose code this one shares after identical code folding.
+        std::string foldedInto;
+    };
+
+    std::vector<FunctionSize> measureFunctionSizes(const std::string& binary, const std::vector<std::string>& functions);
+
+    void printSizeReport(llvm::raw_ostream& out, const std::vector<FunctionSize>& sizes);
+
+    // Writes the report for a linked binary to path, "-" meaning stdout.
+    void writeSizeReport(const std::string& binary, const std::vector<std::string>& functions,
+                         const std::string& path);
+}
+
+#endif //LG_LLVM_IR_GENERATOR_CPP_SIZE_REPORT_H
@@ -0,0 +1,30 @@
+#ifndef LG_LLVM_IR_GENERATOR_CPP_THIN_LTO_H
+#define LG_LLVM_IR_GENERATOR_CPP_THIN_LTO_H
+#include <llvm/IR/Module.h>
+
+#include "linker.h"
+
+#include <string>
+#include <vector>
+
+namespace lg::llvm_ir_gen
+{
+    struct ThinLTOOptions
+    {
+        std::string triple;
+        std::string cpu;
+        std::string features;
+        unsigned optLevel = 2;
+        // 0 uses every hardware thread for the backends.
+        unsigned jobs = 0;
+        // Backend results are cached here when non-empty.
+        std::string cacheDir;
+        // Symbols that must stay visible to the final link; everything else may be internalized.
+        std::vector<std::string> exportedSymbols = {"main"};
+        LinkerKind linker = LinkerKind::CLANG;
+    };
+
+    void compileThinLTO(const std::vector<llvm::Module*>& modules, const ThinLTOOptions& options, std::string output);
+}
+
+#endif //LG_LLVM_IR_GENERATOR_CPP_THIN_LTO_H
@@ -0,0 +1,115 @@
+#ifndef LG_LLVM_IR_GENERATOR_CPP_TIERED_JIT_H
+#define LG_LLVM_IR_GENERATOR_CPP_TIERED_JIT_H
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ExecutionEngine/Orc/IndirectionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace lg::llvm_ir_gen
+{
+    struct TieredJITOptions
+    {
+        // Number of calls after which a function is queued for recompilation.
+        uint64_t tierUpThreshold = 1000;
+        unsigned tier1OptLevel = 2;
+        // Same meaning as in CompileOptions; "native" is the usual choice for a JIT.
+        std::string cpu = "native";
+        std::string features;
+    };
+
+    struct TierUpStatistics
+    {
+        struct Function
+        {
+            std::string name;
+            unsigned tier = 0;
+            // Time from crossing the threshold until the tier-1 body was installed.
+            std::chrono::microseconds tierUpLatency{0};
+        };
+
+        uint64_t tier0Functions = 0;
+        uint64_t tierUpRequests = 0;
+        uint64_t tieredUp = 0;
+        uint64_t failed = 0;
+        std::chrono::microseconds tier1CompileTime{0};
+        std::vector<Function> functions;
+    };
+
+    // Runs a generated module in two tiers. Every function is first compiled without optimization behind an
+    // ORC indirect stub and counts its calls; once a function crosses the threshold a background thread
+    // regenerates it from the module's bitcode at tier1OptLevel and repoints the stub at the new body.
+    class TieredJIT
+    {
+    private:
+        struct FunctionState
+        {
+            std::string name;
+            std::atomic<unsigned> tier = 0;
+            std::chrono::steady_clock::time_point requestedAt;
+            std::chrono::microseconds tierUpLatency{0};
+        };
+
+        TieredJITOptions options;
+        std::unique_ptr<llvm::orc::LLJIT> jit;
+        std::unique_ptr<llvm::orc::IndirectStubsManager> stubsManager;
+        std::string triple;
+        std::string cpu;
+        std::string features;
+        llvm::SmallVector<char, 0> bitcode;
+        std::vector<std::unique_ptr<FunctionState>> functions;
+
+        mutable std::mutex queueMutex;
+        std::condition_variable queueCondition;
+        std::deque<uint64_t> queue;
+        uint64_t pending = 0;
+        bool stopping = false;
+        std::condition_variable idleCondition;
+        std::thread worker;
+
+        std::atomic<uint64_t> tierUpRequests = 0;
+        std::atomic<uint64_t> tieredUp = 0;
+        std::atomic<uint64_t> failed = 0;
+        std::atomic<int64_t> tier1CompileMicroseconds = 0;
+
+        static void tierUpEntry(TieredJIT* jit, uint64_t index);
+        void instrumentTier0(llvm::Module* module);
+        void requestTierUp(uint64_t index);
+        void compileTier1(uint64_t index);
+        void runWorker();
+
+    public:
+        TieredJIT(std::unique_ptr<llvm::LLVMContext> context, std::unique_ptr<llvm::Module> module,
+                  TieredJITOptions options = {});
+
+        ~TieredJIT();
+
+        TieredJIT(const TieredJIT&) = delete;
+        TieredJIT& operator=(const TieredJIT&) = delete;
+
+        llvm::orc::ExecutorAddr lookup(const std::string& name);
+
+        template <typename T>
+        T* lookupFunction(const std::string& name)
+        {
+            return lookup(name).toPtr<T*>();
+        }
+
+        void waitForPendingCompiles();
+
+        TierUpStatistics statistics() const;
+    };
+}
+
+#endif //LG_LLVM_IR_GENERATOR_CPP_TIERED_JIT_H
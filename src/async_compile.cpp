@@ -0,0 +1,223 @@
+#include <async_compile.h>
+
+#include <linker.h>
+#include <remarks.h>
+#include <size_report.h>
+
+#include <algorithm>
+#include <optional>
+
+namespace lg::llvm_ir_gen
+{
+    namespace
+    {
+        struct CompileJob
+        {
+            CompileExecutor& executor;
+            ir::IRModule* module;
+            std::string output;
+            AsyncCompileOptions options;
+            std::promise<void> promise;
+
+            std::unique_ptr<llvm::LLVMContext> context;
+            std::unique_ptr<llvm::Module> llvmModule;
+            std::unique_ptr<llvm::TargetMachine> targetMachine;
+            std::vector<std::string> functions;
+            llvm::SmallVector<char, 0> object;
+            // Declared last so it is destroyed before the context it hooks into.
+            std::optional<RemarkSession> remarks;
+
+            void report(const CompileProgress& progress) const
+            {
+                if (options.onProgress) options.onProgress(progress);
+            }
+        };
+
+        void generateStage(CompileJob& job)
+        {
+            job.context = std::make_unique<llvm::LLVMContext>();
+            job.llvmModule = std::make_unique<llvm::Module>("", *job.context);
+            configureModule(job.llvmModule.get(), job.options.compile);
+
+            auto generatorOptions = job.options.generator;
+            const auto total = job.module->functions.size();
+            size_t completed = 0;
+            generatorOptions.onFunctionGenerated =
+                [&job, &completed, total, callback = std::move(generatorOptions.onFunctionGenerated)](
+                ir::function::IRFunction* function)
+                {
+                    if (callback) callback(function);
+                    job.report({CompileStage::GENERATE, ++completed, total, function->name});
+                    job.options.cancellation.throwIfCancelled();
+                };
+            LLVMIRGenerator generator(job.module, job.context.get(), job.llvmModule.get(),
+                                      std::move(generatorOptions));
+            generator.generate();
+        }
+
+        void optimizeStage(CompileJob& job)
+        {
+            job.targetMachine = prepareModule(job.llvmModule.get(), job.options.compile);
+            job.functions = definedFunctionNames(job.llvmModule.get());
+            if (!job.options.compile.remarksFile.empty() || !job.options.compile.remarksSummary.empty())
+                job.remarks.emplace(*job.context, job.options.compile);
+
+            // Once cancelled, the remaining optional passes are skipped so the stage ends quickly.
+            auto compileOptions = job.options.compile;
+            size_t started = 0;
+            compileOptions.shouldRunPass = [&job, &started, callback = std::move(compileOptions.shouldRunPass)](
+                llvm::StringRef pass)
+            {
+                if (job.options.cancellation.isCancelled()) return false;
+                if (callback && !callback(pass)) return false;
+                job.report({CompileStage::OPTIMIZE, ++started, 0, pass.str()});
+                return true;
+            };
+            optimize(job.llvmModule.get(), job.targetMachine.get(), compileOptions);
+        }
+
+        void emitStage(CompileJob& job)
+        {
+            emitObject(job.llvmModule.get(), job.targetMachine.get(), job.object);
+            if (job.remarks)
+            {
+                job.remarks->finish();
+                job.remarks.reset();
+            }
+            job.llvmModule.reset();
+            job.context.reset();
+        }
+
+        void linkStage(CompileJob& job)
+        {
+            linkObjects({llvm::StringRef(job.object.data(), job.object.size())}, toLinkOptions(job.options.compile),
+                        job.output);
+            if (!job.options.compile.sizeReport.empty())
+                writeSizeReport(job.output, job.functions, job.options.compile.sizeReport);
+        }
+
+        void schedule(const std::shared_ptr<CompileJob>& job, CompileStage stage)
+        {
+            job->executor.submit([job, stage]
+            {
+                try
+                {
+                    job->options.cancellation.throwIfCancelled();
+                    job->report({stage});
+                    switch (stage)
+                    {
+                    case CompileStage::GENERATE:
+                        generateStage(*job);
+                        schedule(job, CompileStage::OPTIMIZE);
+                        break;
+                    case CompileStage::OPTIMIZE:
+                        optimizeStage(*job);
+                        schedule(job, CompileStage::EMIT);
+                        break;
+                    case CompileStage::EMIT:
+                        emitStage(*job);
+                        schedule(job, CompileStage::LINK);
+                        break;
+                    case CompileStage::LINK:
+                        linkStage(*job);
+                        job->promise.set_value();
+                        break;
+                    }
+                }
+                catch (...)
+                {
+                    job->remarks.reset();
+                    job->promise.set_exception(std::current_exception());
+                }
+            });
+        }
+    }
+
+    const char* toString(CompileStage stage)
+    {
+        switch (stage)
+        {
+        case CompileStage::GENERATE:
+            return "generate";
+        case CompileStage::OPTIMIZE:
+            return "optimize";
+        case CompileStage::EMIT:
+            return "emit";
+        case CompileStage::LINK:
+            return "link";
+        default:
+            throw std::runtime_error("unknown compile stage");
+        }
+    }
+
+    CompileCancelled::CompileCancelled() : std::runtime_error("compilation cancelled")
+    {
+    }
+
+    void CancellationToken::cancel() const
+    {
+        cancelled->store(true, std::memory_order_relaxed);
+    }
+
+    bool CancellationToken::isCancelled() const
+    {
+        return cancelled->load(std::memory_order_relaxed);
+    }
+
+    void CancellationToken::throwIfCancelled() const
+    {
+        if (isCancelled()) throw CompileCancelled();
+    }
+
+    CompileExecutor::CompileExecutor(unsigned threads)
+    {
+        threads = std::max(threads, 1u);
+        for (unsigned i = 0; i < threads; ++i) workers.emplace_back([this] { runWorker(); });
+    }
+
+    CompileExecutor::~CompileExecutor()
+    {
+        {
+            std::lock_guard lock(queueMutex);
+            stopping = true;
+        }
+        queueCondition.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    void CompileExecutor::submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard lock(queueMutex);
+            queue.push_back(std::move(task));
+        }
+        queueCondition.notify_one();
+    }
+
+    // A worker only leaves once the queue is empty, and a stage queues its successor before it returns, so
+    // compiles in flight when the executor is destroyed still run to completion.
+    void CompileExecutor::runWorker()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock lock(queueMutex);
+                queueCondition.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (queue.empty()) return;
+                task = std::move(queue.front());
+                queue.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::future<void> compileAsync(CompileExecutor& executor, ir::IRModule* module, std::string output,
+                                   AsyncCompileOptions options)
+    {
+        auto job = std::make_shared<CompileJob>(executor, module, std::move(output), std::move(options));
+        auto future = job->promise.get_future();
+        schedule(job, CompileStage::GENERATE);
+        return future;
+    }
+}
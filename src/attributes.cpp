@@ -0,0 +1,56 @@
+#include <attributes.h>
+
+#include <stdexcept>
+
+namespace lg::llvm_ir_gen
+{
+    namespace
+    {
+        std::string trim(const std::string& text)
+        {
+            const auto begin = text.find_first_not_of(" \t\r\n");
+            if (begin == std::string::npos) return "";
+            const auto end = text.find_last_not_of(" \t\r\n");
+            auto result = text.substr(begin, end - begin + 1);
+            if (result.size() >= 2 && result.front() == '"' && result.back() == '"')
+                result = result.substr(1, result.size() - 2);
+            return result;
+        }
+    }
+
+    Attribute parseAttribute(const std::string& text)
+    {
+        const auto open = text.find('(');
+        if (open == std::string::npos) return {trim(text), {}};
+        const auto close = text.rfind(')');
+        if (close == std::string::npos || close < open) throw std::runtime_error("malformed attribute: " + text);
+        Attribute attribute{trim(text.substr(0, open)), {}};
+        const auto arguments = text.substr(open + 1, close - open - 1);
+        size_t start = 0;
+        while (start <= arguments.size())
+        {
+            auto comma = arguments.find(',', start);
+            if (comma == std::string::npos) comma = arguments.size();
+            auto argument = trim(arguments.substr(start, comma - start));
+            if (!argument.empty()) attribute.arguments.push_back(std::move(argument));
+            start = comma + 1;
+        }
+        return attribute;
+    }
+
+    std::vector<Attribute> findAttributes(const std::vector<std::string>& attributes, const std::string& name)
+    {
+        std::vector<Attribute> result;
+        for (const auto& text : attributes)
+        {
+            auto attribute = parseAttribute(text);
+            if (attribute.name == name) result.push_back(std::move(attribute));
+        }
+        return result;
+    }
+
+    bool hasAttribute(const std::vector<std::string>& attributes, const std::string& name)
+    {
+        return !findAttributes(attributes, name).empty();
+    }
+}
@@ -0,0 +1,1276 @@
+#include <binary_ir.h>
+#include <ir_construction.h>
+
+#include <lg/parser.h>
+#include <llvm/ADT/bit.h>
+#include <llvm/Support/Endian.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/LEB128.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <cstring>
+#include <initializer_list>
+#include <ranges>
+#include <stdexcept>
+#include <type_traits>
+
+namespace lg::llvm_ir_gen
+{
+    namespace
+    {
+        using construction::Type;
+        using construction::Register;
+        using construction::Field;
+        using Operand = std::remove_pointer_t<decltype(ir::instruction::IRStore::value)>;
+        using Instruction = std::remove_pointer_t<decltype(ir::base::IRBasicBlock::instructions)::value_type>;
+
+        enum class TypeTag : uint8_t
+        {
+            INTEGER,
+            FLOAT,
+            DOUBLE,
+            VOID,
+            ARRAY,
+            POINTER,
+            STRUCTURE,
+            FUNCTION_REFERENCE
+        };
+
+        enum class ValueTag : uint8_t
+        {
+            NONE,
+            REGISTER,
+            LOCAL_VARIABLE,
+            FUNCTION_REFERENCE,
+            GLOBAL_VARIABLE_REFERENCE,
+            INTEGER,
+            FLOAT,
+            DOUBLE,
+            NULLPTR,
+            STRING,
+            ARRAY,
+            STRUCTURE_INITIALIZER
+        };
+
+        enum class Opcode : uint8_t
+        {
+            ASSEMBLY,
+            BINARY_OPERATES,
+            UNARY_OPERATES,
+            GET_ELEMENT_POINTER,
+            COMPARE,
+            CONDITIONAL_JUMP,
+            GOTO,
+            INVOKE,
+            RETURN,
+            LOAD,
+            STORE,
+            NOP,
+            SET_REGISTER,
+            STACK_ALLOCATE,
+            TYPE_CAST,
+            PHI,
+            SWITCH
+        };
+
+        constexpr uint64_t NO_INDEX = 0;
+
+        class Encoder
+        {
+        public:
+            llvm::SmallVector<char, 0> bytes;
+            uint64_t count = 0;
+
+            void byte(uint8_t value)
+            {
+                bytes.push_back(static_cast<char>(value));
+            }
+
+            void uleb(uint64_t value)
+            {
+                uint8_t buffer[16];
+                const auto size = llvm::encodeULEB128(value, buffer);
+                bytes.append(buffer, buffer + size);
+            }
+
+            void sleb(int64_t value)
+            {
+                uint8_t buffer[16];
+                const auto size = llvm::encodeSLEB128(value, buffer);
+                bytes.append(buffer, buffer + size);
+            }
+
+            template <typename T>
+            void fixed(T value)
+            {
+                char buffer[sizeof(T)];
+                llvm::support::endian::write<T, llvm::endianness::little>(buffer, value);
+                bytes.append(buffer, buffer + sizeof(T));
+            }
+
+            void append(const Encoder& other)
+            {
+                bytes.append(other.bytes.begin(), other.bytes.end());
+            }
+        };
+
+        class Decoder
+        {
+        private:
+            const uint8_t* position;
+            const uint8_t* end;
+
+            void require(size_t size) const
+            {
+                if (static_cast<size_t>(end - position) < size) throw std::runtime_error("truncated lg binary IR");
+            }
+
+        public:
+            explicit Decoder(llvm::StringRef data) : position(data.bytes_begin()), end(data.bytes_end())
+            {
+            }
+
+            uint8_t byte()
+            {
+                require(1);
+                return *position++;
+            }
+
+            uint64_t uleb()
+            {
+                unsigned size;
+                const char* error = nullptr;
+                const auto value = llvm::decodeULEB128(position, &size, end, &error);
+                if (error != nullptr) throw std::runtime_error(std::string("malformed lg binary IR: ") + error);
+                position += size;
+                return value;
+            }
+
+            int64_t sleb()
+            {
+                unsigned size;
+                const char* error = nullptr;
+                const auto value = llvm::decodeSLEB128(position, &size, end, &error);
+                if (error != nullptr) throw std::runtime_error(std::string("malformed lg binary IR: ") + error);
+                position += size;
+                return value;
+            }
+
+            template <typename T>
+            T fixed()
+            {
+                require(sizeof(T));
+                const auto value = llvm::support::endian::read<T, llvm::endianness::little>(position);
+                position += sizeof(T);
+                return value;
+            }
+
+            llvm::StringRef bytes(size_t size)
+            {
+                require(size);
+                const llvm::StringRef result(reinterpret_cast<const char*>(position), size);
+                position += size;
+                return result;
+            }
+
+            bool done() const
+            {
+                return position == end;
+            }
+        };
+
+        std::string readString(Decoder& in, const std::vector<llvm::StringRef>& strings)
+        {
+            const auto index = in.uleb();
+            if (index >= strings.size()) throw std::runtime_error("invalid string index in lg binary IR");
+            return strings[index].str();
+        }
+
+        template <typename T>
+        T* checkIndex(const std::vector<T*>& table, uint64_t index, const char* what)
+        {
+            if (index >= table.size()) throw std::runtime_error(std::string("invalid ") + what + " index in lg binary IR");
+            return table[index];
+        }
+
+        // Types and constants come from the file, so their kinds are checked rather than assumed.
+        template <typename T, typename U>
+        T* checkKind(U* value, const char* what)
+        {
+            if constexpr (std::is_same_v<T, U>) return value;
+            else
+            {
+                auto* result = dynamic_cast<T*>(value);
+                if (result == nullptr && value != nullptr)
+                    throw std::runtime_error(std::string("invalid ") + what + " in lg binary IR");
+                return result;
+            }
+        }
+
+        template <typename Enum>
+        Enum checkEnum(uint8_t byte, std::initializer_list<Enum> values, const char* what)
+        {
+            for (const auto value : values)
+                if (static_cast<uint8_t>(value) == byte) return value;
+            throw std::runtime_error(std::string("invalid ") + what + " in lg binary IR");
+        }
+
+        class BinaryIRWriter final : public ir::IRVisitor
+        {
+        private:
+            Encoder* out = nullptr;
+            Encoder strings;
+            Encoder structures;
+            Encoder types;
+            Encoder fields;
+            Encoder functions;
+            Encoder globals;
+            Encoder bodies;
+            std::unordered_map<std::string, uint64_t> stringIndices;
+            std::unordered_map<std::string, uint64_t> typeIndices;
+            std::unordered_map<ir::structure::IRStructure*, uint64_t> structureIndices;
+            std::unordered_map<ir::function::IRFunction*, uint64_t> functionIndices;
+            std::unordered_map<ir::base::IRGlobalVariable*, uint64_t> globalIndices;
+            std::unordered_map<ir::base::IRBasicBlock*, uint64_t> blockIndices;
+            std::unordered_map<ir::function::IRLocalVariable*, uint64_t> variableIndices;
+            std::unordered_map<Register*, uint64_t> registerIndices;
+            std::vector<Register*> registers;
+
+            uint64_t string(const std::string& value)
+            {
+                const auto [it, inserted] = stringIndices.try_emplace(value, strings.count);
+                if (inserted)
+                {
+                    strings.uleb(value.size());
+                    strings.bytes.append(value.begin(), value.end());
+                    ++strings.count;
+                }
+                return it->second;
+            }
+
+            void attributes(Encoder& encoder, const std::vector<std::string>& values)
+            {
+                encoder.uleb(values.size());
+                for (const auto& value : values) encoder.uleb(string(value));
+            }
+
+            // Types are encoded into a scratch buffer and deduplicated on the encoding.
+            uint64_t type(Type* value)
+            {
+                Encoder encoding;
+                auto* previous = out;
+                out = &encoding;
+                visit(value, nullptr);
+                out = previous;
+                const std::string key(encoding.bytes.begin(), encoding.bytes.end());
+                const auto [it, inserted] = typeIndices.try_emplace(key, types.count);
+                if (inserted)
+                {
+                    types.append(encoding);
+                    ++types.count;
+                }
+                return it->second;
+            }
+
+            // Index 0 stands for a missing operand.
+            void operand(Operand* value)
+            {
+                if (value == nullptr)
+                {
+                    out->byte(static_cast<uint8_t>(ValueTag::NONE));
+                    return;
+                }
+                visit(value, nullptr);
+            }
+
+            uint64_t reg(Register* value)
+            {
+                if (value == nullptr) return NO_INDEX;
+                const auto [it, inserted] = registerIndices.try_emplace(value, registers.size() + 1);
+                if (inserted) registers.push_back(value);
+                return it->second;
+            }
+
+            uint64_t block(ir::base::IRBasicBlock* value)
+            {
+                return blockIndices.at(value);
+            }
+
+            void writeFunction(ir::function::IRFunction* function)
+            {
+                functions.uleb(string(function->name));
+                attributes(functions, function->attributes);
+                functions.byte(function->isExtern);
+                functions.byte(function->isVarArg);
+                functions.uleb(type(function->returnType));
+                variableIndices.clear();
+                functions.uleb(function->args.size());
+                for (auto* arg : function->args)
+                {
+                    variableIndices[arg] = variableIndices.size();
+                    functions.uleb(string(arg->name));
+                    functions.uleb(type(arg->type));
+                }
+                functions.uleb(function->locals.size());
+                for (auto* local : function->locals)
+                {
+                    variableIndices[local] = variableIndices.size();
+                    functions.uleb(string(local->name));
+                    functions.uleb(type(local->type));
+                }
+                if (function->isExtern)
+                {
+                    functions.uleb(0);
+                    functions.uleb(0);
+                    return;
+                }
+
+                blockIndices.clear();
+                registerIndices.clear();
+                registers.clear();
+                for (auto* basicBlock : function->cfg->basicBlocks | std::views::values)
+                    blockIndices[basicBlock] = blockIndices.size();
+                Encoder instructions;
+                out = &instructions;
+                for (auto* basicBlock : function->cfg->basicBlocks | std::views::values)
+                {
+                    instructions.uleb(basicBlock->instructions.size());
+                    for (auto* instruction : basicBlock->instructions) visit(instruction, nullptr);
+                }
+                out = nullptr;
+
+                Encoder body;
+                body.uleb(registers.size());
+                for (auto* value : registers)
+                {
+                    body.uleb(string(value->name));
+                    body.uleb(type(value->getType()));
+                }
+                body.uleb(blockIndices.size());
+                for (auto* basicBlock : function->cfg->basicBlocks | std::views::values)
+                    body.uleb(string(basicBlock->name));
+                body.append(instructions);
+
+                functions.uleb(bodies.bytes.size());
+                functions.uleb(body.bytes.size());
+                bodies.append(body);
+            }
+
+            void writeGlobal(ir::base::IRGlobalVariable* global)
+            {
+                globals.uleb(string(global->name));
+                attributes(globals, global->attributes);
+                globals.byte(global->isConstant);
+                globals.uleb(type(global->type));
+            }
+
+        public:
+            void write(ir::IRModule* module, llvm::SmallVectorImpl<char>& output)
+            {
+                for (auto* structure : module->structures | std::views::values)
+                {
+                    structureIndices[structure] = structures.count++;
+                    structures.uleb(string(structure->name));
+                    attributes(structures, structure->attributes);
+                }
+                for (auto* function : module->functions | std::views::values)
+                    functionIndices[function] = functionIndices.size();
+                for (auto* global : module->globals | std::views::values)
+                    globalIndices[global] = globalIndices.size();
+
+                for (auto* structure : module->structures | std::views::values)
+                {
+                    fields.uleb(structure->fields.size());
+                    for (auto* field : structure->fields)
+                    {
+                        fields.uleb(string(field->name));
+                        fields.uleb(type(field->type));
+                    }
+                }
+                for (auto* function : module->functions | std::views::values) writeFunction(function);
+                for (auto* global : module->globals | std::views::values) writeGlobal(global);
+                // Initializers follow all declarations since they may refer to globals declared later.
+                out = &globals;
+                for (auto* global : module->globals | std::views::values) operand(global->initializer);
+                out = nullptr;
+
+                const std::vector<std::pair<BinaryIRSection, Encoder*>> sections = {
+                    {BinaryIRSection::STRINGS, &strings},
+                    {BinaryIRSection::STRUCTURES, &structures},
+                    {BinaryIRSection::TYPES, &types},
+                    {BinaryIRSection::FIELDS, &fields},
+                    {BinaryIRSection::FUNCTIONS, &functions},
+                    {BinaryIRSection::GLOBALS, &globals},
+                    {BinaryIRSection::BODIES, &bodies},
+                };
+                const std::unordered_map<Encoder*, uint64_t> counts = {
+                    {&strings, strings.count},
+                    {&structures, structures.count},
+                    {&types, types.count},
+                    {&fields, structures.count},
+                    {&functions, functionIndices.size()},
+                    {&globals, globalIndices.size()},
+                    {&bodies, 0},
+                };
+
+                Encoder header;
+                header.bytes.append(std::begin(BINARY_IR_MAGIC), std::end(BINARY_IR_MAGIC));
+                header.fixed<uint32_t>(BINARY_IR_VERSION);
+                header.fixed<uint32_t>(sections.size());
+                uint64_t offset = header.bytes.size() + sections.size() * (sizeof(uint32_t) + 2 * sizeof(uint64_t));
+                std::vector<Encoder> contents;
+                for (const auto& [kind, encoder] : sections)
+                {
+                    Encoder content;
+                    if (encoder != &bodies) content.uleb(counts.at(encoder));
+                    content.append(*encoder);
+                    header.fixed<uint32_t>(static_cast<uint32_t>(kind));
+                    header.fixed<uint64_t>(offset);
+                    header.fixed<uint64_t>(content.bytes.size());
+                    offset += content.bytes.size();
+                    contents.push_back(std::move(content));
+                }
+                output.append(header.bytes.begin(), header.bytes.end());
+                for (const auto& content : contents) output.append(content.bytes.begin(), content.bytes.end());
+            }
+
+            std::any visitModule(ir::IRModule* module, std::any additional) override
+            {
+                return nullptr;
+            }
+
+            std::any visitGlobalVariable(ir::base::IRGlobalVariable* irGlobalVariable, std::any additional) override
+            {
+                return nullptr;
+            }
+
+            std::any visitStructure(ir::structure::IRStructure* irStructure, std::any additional) override
+            {
+                return nullptr;
+            }
+
+            std::any visitFunction(ir::function::IRFunction* irFunction, std::any additional) override
+            {
+                return nullptr;
+            }
+
+            std::any visitAssembly(ir::instruction::IRAssembly* irAssembly, std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(Opcode::ASSEMBLY));
+                out->uleb(string(irAssembly->assembly));
+                out->uleb(string(irAssembly->constraints));
+                out->uleb(irAssembly->operands.size());
+                for (auto* value : irAssembly->operands) operand(value);
+                return nullptr;
+            }
+
+            std::any visitBinaryOperates(ir::instruction::IRBinaryOperates* irBinaryOperates,
+                                         std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(Opcode::BINARY_OPERATES));
+                out->byte(static_cast<uint8_t>(irBinaryOperates->op));
+                operand(irBinaryOperates->operand1);
+                operand(irBinaryOperates->operand2);
+                out->uleb(reg(irBinaryOperates->target));
+                return nullptr;
+            }
+
+            std::any visitUnaryOperates(ir::instruction::IRUnaryOperates* irUnaryOperates, std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(Opcode::UNARY_OPERATES));
+                out->byte(static_cast<uint8_t>(irUnaryOperates->op));
+                operand(irUnaryOperates->operand);
+                out->uleb(reg(irUnaryOperates->target));
+                return nullptr;
+            }
+
+            std::any visitGetElementPointer(ir::instruction::IRGetElementPointer* irGetElementPointer,
+                                            std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(Opcode::GET_ELEMENT_POINTER));
+                operand(irGetElementPointer->pointer);
+                out->uleb(irGetElementPointer->indices.size());
+                for (auto* index : irGetElementPointer->indices) operand(index);
+                out->uleb(reg(irGetElementPointer->target));
+                return nullptr;
+            }
+
+            std::any visitCompare(ir::instruction::IRCompare* irCompare, std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(Opcode::COMPARE));
+                out->byte(static_cast<uint8_t>(irCompare->condition));
+                operand(irCompare->operand1);
+                operand(irCompare->operand2);
+                out->uleb(reg(irCompare->target));
+                return nullptr;
+            }
+
+            std::any visitConditionalJump(ir::instruction::IRConditionalJump* irConditionalJump,
+                                          std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(Opcode::CONDITIONAL_JUMP));
+                out->byte(static_cast<uint8_t>(irConditionalJump->condition));
+                operand(irConditionalJump->operand1);
+                operand(irConditionalJump->operand2);
+                out->uleb(block(irConditionalJump->target));
+                return nullptr;
+            }
+
+            std::any visitGoto(ir::instruction::IRGoto* irGoto, std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(Opcode::GOTO));
+                out->uleb(block(irGoto->target));
+                return nullptr;
+            }
+
+            std::any visitInvoke(ir::instruction::IRInvoke* irInvoke, std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(Opcode::INVOKE));
+                out->uleb(type(irInvoke->func->getType()));
+                operand(irInvoke->func);
+                out->uleb(irInvoke->arguments.size());
+                for (auto* argument : irInvoke->arguments) operand(argument);
+                out->uleb(reg(irInvoke->target));
+                return nullptr;
+            }
+
+            std::any visitReturn(ir::instruction::IRReturn* irReturn, std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(Opcode::RETURN));
+                operand(irReturn->value);
+                return nullptr;
+            }
+
+            std::any visitLoad(ir::instruction::IRLoad* irLoad, std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(Opcode::LOAD));
+                operand(irLoad->ptr);
+                out->uleb(reg(irLoad->target));
+                return nullptr;
+            }
+
+            std::any visitStore(ir::instruction::IRStore* irStore, std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(Opcode::STORE));
+                operand(irStore->ptr);
+                operand(irStore->value);
+                return nullptr;
+            }
+
+            std::any visitNop(ir::instruction::IRNop* irNop, std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(Opcode::NOP));
+                return nullptr;
+            }
+
+            std::any visitSetRegister(ir::instruction::IRSetRegister* irSetRegister, std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(Opcode::SET_REGISTER));
+                operand(irSetRegister->value);
+                out->uleb(reg(irSetRegister->target));
+                return nullptr;
+            }
+
+            std::any visitStackAllocate(ir::instruction::IRStackAllocate* irStackAllocate,
+                                        std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(Opcode::STACK_ALLOCATE));
+                out->uleb(type(irStackAllocate->type));
+                operand(irStackAllocate->size);
+                out->uleb(reg(irStackAllocate->target));
+                return nullptr;
+            }
+
+            std::any visitTypeCast(ir::instruction::IRTypeCast* irTypeCast, std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(Opcode::TYPE_CAST));
+                out->byte(static_cast<uint8_t>(irTypeCast->kind));
+                operand(irTypeCast->source);
+                out->uleb(type(irTypeCast->targetType));
+                out->uleb(reg(irTypeCast->target));
+                return nullptr;
+            }
+
+            std::any visitPhi(ir::instruction::IRPhi* irPhi, std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(Opcode::PHI));
+                out->uleb(irPhi->values.size());
+                for (auto& [basicBlock, value] : irPhi->values)
+                {
+                    out->uleb(block(basicBlock));
+                    operand(value);
+                }
+                out->uleb(reg(irPhi->target));
+                return nullptr;
+            }
+
+            std::any visitSwitch(ir::instruction::IRSwitch* irSwitch, std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(Opcode::SWITCH));
+                operand(irSwitch->value);
+                out->uleb(block(irSwitch->defaultCase));
+                out->uleb(irSwitch->cases.size());
+                for (auto& [value, basicBlock] : irSwitch->cases)
+                {
+                    operand(value);
+                    out->uleb(block(basicBlock));
+                }
+                return nullptr;
+            }
+
+            std::any visitRegister(ir::value::IRRegister* irRegister, std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(ValueTag::REGISTER));
+                out->uleb(reg(irRegister));
+                return nullptr;
+            }
+
+            std::any visitLocalVariableReference(ir::value::IRLocalVariableReference* irLocalVariableReference,
+                                                 std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(ValueTag::LOCAL_VARIABLE));
+                out->uleb(variableIndices.at(irLocalVariableReference->variable));
+                return nullptr;
+            }
+
+            std::any visitFunctionReference(ir::value::constant::IRFunctionReference* irFunctionReference,
+                                            std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(ValueTag::FUNCTION_REFERENCE));
+                out->uleb(functionIndices.at(irFunctionReference->function));
+                return nullptr;
+            }
+
+            std::any visitGlobalVariableReference(
+                ir::value::constant::IRGlobalVariableReference* irGlobalVariableReference,
+                std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(ValueTag::GLOBAL_VARIABLE_REFERENCE));
+                out->uleb(globalIndices.at(irGlobalVariableReference->variable));
+                return nullptr;
+            }
+
+            std::any visitIntegerConstant(ir::value::constant::IRIntegerConstant* irIntegerConstant,
+                                          std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(ValueTag::INTEGER));
+                out->uleb(type(irIntegerConstant->type));
+                out->sleb(static_cast<int64_t>(irIntegerConstant->value));
+                return nullptr;
+            }
+
+            std::any visitFloatConstant(ir::value::constant::IRFloatConstant* irFloatConstant,
+                                        std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(ValueTag::FLOAT));
+                out->fixed<uint32_t>(llvm::bit_cast<uint32_t>(static_cast<float>(irFloatConstant->value)));
+                return nullptr;
+            }
+
+            std::any visitDoubleConstant(ir::value::constant::IRDoubleConstant* irDoubleConstant,
+                                         std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(ValueTag::DOUBLE));
+                out->fixed<uint64_t>(llvm::bit_cast<uint64_t>(static_cast<double>(irDoubleConstant->value)));
+                return nullptr;
+            }
+
+            std::any visitNullptrConstant(ir::value::constant::IRNullptrConstant* irNullptrConstant,
+                                          std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(ValueTag::NULLPTR));
+                return nullptr;
+            }
+
+            std::any visitStringConstant(ir::value::constant::IRStringConstant* irStringConstant,
+                                         std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(ValueTag::STRING));
+                out->uleb(string(irStringConstant->value));
+                return nullptr;
+            }
+
+            std::any visitArrayConstant(ir::value::constant::IRArrayConstant* irArrayConstant,
+                                        std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(ValueTag::ARRAY));
+                out->uleb(type(irArrayConstant->type));
+                out->uleb(irArrayConstant->elements.size());
+                for (auto* element : irArrayConstant->elements) operand(element);
+                return nullptr;
+            }
+
+            std::any visitStructureInitializer(ir::value::constant::IRStructureInitializer* irStructureInitializer,
+                                               std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(ValueTag::STRUCTURE_INITIALIZER));
+                out->uleb(type(irStructureInitializer->type));
+                out->uleb(irStructureInitializer->elements.size());
+                for (auto* element : irStructureInitializer->elements) operand(element);
+                return nullptr;
+            }
+
+            std::any visitIntegerType(ir::type::IRIntegerType* irIntegerType, std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(TypeTag::INTEGER));
+                out->uleb(static_cast<uint64_t>(irIntegerType->size));
+                out->byte(irIntegerType->_unsigned);
+                return nullptr;
+            }
+
+            std::any visitFloatType(ir::type::IRFloatType* irFloatType, std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(TypeTag::FLOAT));
+                return nullptr;
+            }
+
+            std::any visitDoubleType(ir::type::IRDoubleType* irDoubleType, std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(TypeTag::DOUBLE));
+                return nullptr;
+            }
+
+            std::any visitVoidType(ir::type::IRVoidType* irVoidType, std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(TypeTag::VOID));
+                return nullptr;
+            }
+
+            std::any visitArrayType(ir::type::IRArrayType* irArrayType, std::any additional) override
+            {
+                const auto base = type(irArrayType->base);
+                out->byte(static_cast<uint8_t>(TypeTag::ARRAY));
+                out->uleb(base);
+                out->uleb(irArrayType->size);
+                return nullptr;
+            }
+
+            std::any visitPointerType(ir::type::IRPointerType* irPointerType, std::any additional) override
+            {
+                const auto base = type(irPointerType->base);
+                out->byte(static_cast<uint8_t>(TypeTag::POINTER));
+                out->uleb(base);
+                return nullptr;
+            }
+
+            std::any visitStructureType(ir::type::IRStructureType* irStructureType, std::any additional) override
+            {
+                out->byte(static_cast<uint8_t>(TypeTag::STRUCTURE));
+                out->uleb(structureIndices.at(irStructureType->structure));
+                return nullptr;
+            }
+
+            std::any visitFunctionReferenceType(ir::type::IRFunctionReferenceType* irFunctionReferenceType,
+                                                std::any additional) override
+            {
+                const auto returnType = type(irFunctionReferenceType->returnType);
+                std::vector<uint64_t> parameterTypes;
+                for (auto* parameterType : irFunctionReferenceType->parameterTypes)
+                    parameterTypes.push_back(type(parameterType));
+                out->byte(static_cast<uint8_t>(TypeTag::FUNCTION_REFERENCE));
+                out->uleb(returnType);
+                out->uleb(parameterTypes.size());
+                for (const auto parameterType : parameterTypes) out->uleb(parameterType);
+                out->byte(irFunctionReferenceType->isVarArg);
+                return nullptr;
+            }
+        };
+
+        // Decodes one function body. Registers are created from the body's table before any instruction refers
+        // to them, so forward references from phis need no fixups.
+        class BodyReader
+        {
+        private:
+            Decoder& in;
+            const std::vector<llvm::StringRef>& strings;
+            const std::vector<Type*>& types;
+            const std::vector<ir::function::IRFunction*>& functions;
+            const std::vector<ir::base::IRGlobalVariable*>& globals;
+            const std::vector<ir::function::IRLocalVariable*>& variables;
+            std::vector<Register*> registers;
+            std::vector<ir::base::IRBasicBlock*> blocks;
+
+            Register* reg()
+            {
+                const auto index = in.uleb();
+                if (index == NO_INDEX) return nullptr;
+                return checkIndex(registers, index - 1, "register");
+            }
+
+            ir::base::IRBasicBlock* block()
+            {
+                return checkIndex(blocks, in.uleb(), "block");
+            }
+
+            Type* type()
+            {
+                return checkIndex(types, in.uleb(), "type");
+            }
+
+            ir::base::IRCondition readCondition()
+            {
+                using Condition = ir::base::IRCondition;
+                return checkEnum(in.byte(), {Condition::E, Condition::NE, Condition::L, Condition::LE, Condition::G,
+                                 Condition::GE, Condition::IF_TRUE, Condition::IF_FALSE}, "condition");
+            }
+
+            template <typename Container>
+            Container operands()
+            {
+                Container result;
+                const auto count = in.uleb();
+                using Element = std::remove_pointer_t<typename Container::value_type>;
+                for (uint64_t i = 0; i < count; ++i) result.push_back(checkKind<Element>(operand(), "operand"));
+                return result;
+            }
+
+        public:
+            BodyReader(Decoder& in, const std::vector<llvm::StringRef>& strings, const std::vector<Type*>& types,
+                       const std::vector<ir::function::IRFunction*>& functions,
+                       const std::vector<ir::base::IRGlobalVariable*>& globals,
+                       const std::vector<ir::function::IRLocalVariable*>& variables)
+                : in(in), strings(strings), types(types), functions(functions), globals(globals),
+                  variables(variables)
+            {
+            }
+
+            std::string string()
+            {
+                return readString(in, strings);
+            }
+
+            Operand* operand()
+            {
+                switch (static_cast<ValueTag>(in.byte()))
+                {
+                case ValueTag::NONE:
+                    return nullptr;
+                case ValueTag::REGISTER:
+                    return reg();
+                case ValueTag::LOCAL_VARIABLE:
+                    return new ir::value::IRLocalVariableReference(checkIndex(variables, in.uleb(), "variable"));
+                case ValueTag::FUNCTION_REFERENCE:
+                    return new ir::value::constant::IRFunctionReference(checkIndex(functions, in.uleb(), "function"));
+                case ValueTag::GLOBAL_VARIABLE_REFERENCE:
+                    return new ir::value::constant::IRGlobalVariableReference(checkIndex(globals, in.uleb(), "global"));
+                case ValueTag::INTEGER:
+                    {
+                        auto* integerType = checkKind<ir::type::IRIntegerType>(type(), "type");
+                        return makeIntegerConstant(integerType, in.sleb());
+                    }
+                case ValueTag::FLOAT:
+                    return new ir::value::constant::IRFloatConstant(llvm::bit_cast<float>(in.fixed<uint32_t>()));
+                case ValueTag::DOUBLE:
+                    return new ir::value::constant::IRDoubleConstant(llvm::bit_cast<double>(in.fixed<uint64_t>()));
+                case ValueTag::NULLPTR:
+                    return new ir::value::constant::IRNullptrConstant();
+                case ValueTag::STRING:
+                    return new ir::value::constant::IRStringConstant(string());
+                case ValueTag::ARRAY:
+                    {
+                        auto* arrayType = checkKind<ir::type::IRArrayType>(type(), "type");
+                        return makeArrayConstant(
+                            arrayType, operands<decltype(ir::value::constant::IRArrayConstant::elements)>());
+                    }
+                case ValueTag::STRUCTURE_INITIALIZER:
+                    {
+                        auto* structureType = checkKind<ir::type::IRStructureType>(type(), "type");
+                        return new ir::value::constant::IRStructureInitializer(
+                            structureType, operands<decltype(ir::value::constant::IRStructureInitializer::elements)>());
+                    }
+                default:
+                    throw std::runtime_error("unknown value tag in lg binary IR");
+                }
+            }
+
+            void readBody(ir::function::IRFunction* function)
+            {
+                const auto registerCount = in.uleb();
+                for (uint64_t i = 0; i < registerCount; ++i)
+                {
+                    auto name = string();
+                    registers.push_back(makeRegister(std::move(name), type()));
+                }
+                const auto blockCount = in.uleb();
+                for (uint64_t i = 0; i < blockCount; ++i) blocks.push_back(makeBasicBlock(function->cfg, string()));
+                for (auto* basicBlock : blocks)
+                {
+                    const auto instructionCount = in.uleb();
+                    for (uint64_t i = 0; i < instructionCount; ++i) basicBlock->instructions.push_back(instruction());
+                }
+                if (!in.done()) throw std::runtime_error("trailing bytes in body of " + function->name);
+            }
+
+            Instruction* instruction()
+            {
+                using namespace ir::instruction;
+                switch (static_cast<Opcode>(in.byte()))
+                {
+                case Opcode::ASSEMBLY:
+                    {
+                        auto assembly = string();
+                        auto constraints = string();
+                        return new IRAssembly(std::move(assembly), std::move(constraints),
+                                              operands<decltype(IRAssembly::operands)>());
+                    }
+                case Opcode::BINARY_OPERATES:
+                    {
+                        using Operator = IRBinaryOperates::Operator;
+                        const auto op = checkEnum(in.byte(), {Operator::ADD, Operator::SUB, Operator::MUL,
+                                                  Operator::DIV, Operator::MOD, Operator::AND, Operator::OR,
+                                                  Operator::XOR, Operator::SHL, Operator::SHR, Operator::USHR},
+                                                  "binary operator");
+                        auto* operand1 = operand();
+                        auto* operand2 = operand();
+                        return new IRBinaryOperates(op, operand1, operand2, reg());
+                    }
+                case Opcode::UNARY_OPERATES:
+                    {
+                        using Operator = IRUnaryOperates::Operator;
+                        const auto op = checkEnum(in.byte(), {Operator::INC, Operator::DEC, Operator::NOT,
+                                                  Operator::NEG}, "unary operator");
+                        auto* value = operand();
+                        return new IRUnaryOperates(op, value, reg());
+                    }
+                case Opcode::GET_ELEMENT_POINTER:
+                    {
+                        auto* pointer = operand();
+                        auto indices = operands<decltype(IRGetElementPointer::indices)>();
+                        return new IRGetElementPointer(pointer, std::move(indices), reg());
+                    }
+                case Opcode::COMPARE:
+                    {
+                        const auto condition = readCondition();
+                        auto* operand1 = operand();
+                        auto* operand2 = operand();
+                        return new IRCompare(condition, operand1, operand2, reg());
+                    }
+                case Opcode::CONDITIONAL_JUMP:
+                    {
+                        const auto condition = readCondition();
+                        auto* operand1 = operand();
+                        auto* operand2 = operand();
+                        return new IRConditionalJump(condition, operand1, operand2, block());
+                    }
+                case Opcode::GOTO:
+                    return new IRGoto(block());
+                case Opcode::INVOKE:
+                    {
+                        auto* functionType = checkKind<ir::type::IRFunctionReferenceType>(type(), "type");
+                        auto* func = operand();
+                        auto arguments = operands<decltype(IRInvoke::arguments)>();
+                        return new IRInvoke(functionType->returnType, func, std::move(arguments), reg());
+                    }
+                case Opcode::RETURN:
+                    return new IRReturn(operand());
+                case Opcode::LOAD:
+                    {
+                        auto* ptr = operand();
+                        return new IRLoad(ptr, reg());
+                    }
+                case Opcode::STORE:
+                    {
+                        auto* ptr = operand();
+                        auto* value = operand();
+                        return new IRStore(ptr, value);
+                    }
+                case Opcode::NOP:
+                    return new IRNop();
+                case Opcode::SET_REGISTER:
+                    {
+                        auto* value = operand();
+                        return new IRSetRegister(reg(), value);
+                    }
+                case Opcode::STACK_ALLOCATE:
+                    {
+                        auto* allocatedType = type();
+                        auto* size = operand();
+                        return new IRStackAllocate(allocatedType, size, reg());
+                    }
+                case Opcode::TYPE_CAST:
+                    {
+                        using Kind = IRTypeCast::Kind;
+                        const auto kind = checkEnum(in.byte(), {Kind::ZEXT, Kind::SEXT, Kind::TRUNC, Kind::INTTOF,
+                                                    Kind::FTOINT, Kind::FTRUNC, Kind::PTRTOINT, Kind::INTTOPTR,
+                                                    Kind::PTRTOPTR, Kind::BITCAST}, "type cast kind");
+                        auto* source = operand();
+                        auto* targetType = type();
+                        return new IRTypeCast(kind, source, targetType, reg());
+                    }
+                case Opcode::PHI:
+                    {
+                        decltype(IRPhi::values) values;
+                        using Entry = decltype(IRPhi::values)::value_type;
+                        const auto count = in.uleb();
+                        for (uint64_t i = 0; i < count; ++i)
+                        {
+                            auto* basicBlock = block();
+                            auto* value = operand();
+                            values.insert(values.end(), Entry(basicBlock, value));
+                        }
+                        return new IRPhi(std::move(values), reg());
+                    }
+                case Opcode::SWITCH:
+                    {
+                        auto* value = operand();
+                        auto* defaultCase = block();
+                        decltype(IRSwitch::cases) cases;
+                        using Entry = decltype(IRSwitch::cases)::value_type;
+                        using CaseValue = std::remove_const_t<Entry::first_type>;
+                        const auto count = in.uleb();
+                        for (uint64_t i = 0; i < count; ++i)
+                        {
+                            auto* caseValue = checkKind<std::remove_pointer_t<CaseValue>>(operand(), "switch case");
+                            cases.insert(cases.end(), Entry(caseValue, block()));
+                        }
+                        return new IRSwitch(value, defaultCase, std::move(cases));
+                    }
+                default:
+                    throw std::runtime_error("unknown opcode in lg binary IR");
+                }
+            }
+        };
+
+    }
+
+    void writeBinaryModule(ir::IRModule* module, llvm::SmallVectorImpl<char>& output)
+    {
+        BinaryIRWriter().write(module, output);
+    }
+
+    void writeBinaryModule(ir::IRModule* module, const std::string& path)
+    {
+        llvm::SmallVector<char, 0> output;
+        writeBinaryModule(module, output);
+        std::error_code error;
+        llvm::raw_fd_ostream out(path, error, llvm::sys::fs::OF_None);
+        if (error) throw std::runtime_error("Failed to open " + path + ": " + error.message());
+        out.write(output.data(), output.size());
+    }
+
+    void convertTextToBinary(const std::string& code, const std::string& path)
+    {
+        writeBinaryModule(ir::parser::parse(code), path);
+    }
+
+    BinaryIRModule::BinaryIRModule(const std::string& path)
+    {
+        // Large files are mapped rather than read; the strings below point straight into the mapping.
+        auto file = llvm::MemoryBuffer::getFile(path, false, false);
+        if (!file) throw std::runtime_error("Failed to open " + path + ": " + file.getError().message());
+        buffer = std::move(*file);
+        module = makeModule();
+        readHeader();
+        readStrings();
+        readStructures();
+        readTypes();
+        readFields();
+        readFunctions();
+        readGlobals();
+    }
+
+    ir::IRModule* BinaryIRModule::getModule() const
+    {
+        return module;
+    }
+
+    llvm::StringRef BinaryIRModule::getSection(BinaryIRSection kind) const
+    {
+        const auto it = sections.find(kind);
+        if (it == sections.end()) throw std::runtime_error("lg binary IR is missing a section");
+        return it->second;
+    }
+
+    void BinaryIRModule::readHeader()
+    {
+        Decoder in(buffer->getBuffer());
+        if (in.bytes(sizeof(BINARY_IR_MAGIC)) != llvm::StringRef(BINARY_IR_MAGIC, sizeof(BINARY_IR_MAGIC)))
+            throw std::runtime_error(buffer->getBufferIdentifier().str() + " is not an lg binary IR file");
+        if (const auto version = in.fixed<uint32_t>(); version != BINARY_IR_VERSION)
+            throw std::runtime_error("unsupported lg binary IR version " + std::to_string(version));
+        const auto count = in.fixed<uint32_t>();
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const auto kind = static_cast<BinaryIRSection>(in.fixed<uint32_t>());
+            const auto offset = in.fixed<uint64_t>();
+            const auto size = in.fixed<uint64_t>();
+            if (offset > buffer->getBufferSize() || size > buffer->getBufferSize() - offset)
+                throw std::runtime_error("lg binary IR section out of bounds");
+            sections[kind] = buffer->getBuffer().substr(offset, size);
+        }
+    }
+
+    void BinaryIRModule::readStrings()
+    {
+        Decoder in(getSection(BinaryIRSection::STRINGS));
+        const auto count = in.uleb();
+        strings.reserve(count);
+        for (uint64_t i = 0; i < count; ++i) strings.push_back(in.bytes(in.uleb()));
+    }
+
+    void BinaryIRModule::readStructures()
+    {
+        Decoder in(getSection(BinaryIRSection::STRUCTURES));
+        const auto count = in.uleb();
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            auto name = readString(in, strings);
+            std::vector<std::string> attributes(in.uleb());
+            for (auto& attribute : attributes) attribute = readString(in, strings);
+            structures.push_back(makeStructure(std::move(attributes), std::move(name)));
+            addStructure(module, structures.back());
+        }
+    }
+
+    void BinaryIRModule::readTypes()
+    {
+        Decoder in(getSection(BinaryIRSection::TYPES));
+        const auto count = in.uleb();
+        types.reserve(count);
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            switch (static_cast<TypeTag>(in.byte()))
+            {
+            case TypeTag::INTEGER:
+                {
+                    const auto size = in.uleb();
+                    types.push_back(makeIntegerType(size, in.byte() != 0));
+                    break;
+                }
+            case TypeTag::FLOAT:
+                types.push_back(new ir::type::IRFloatType());
+                break;
+            case TypeTag::DOUBLE:
+                types.push_back(new ir::type::IRDoubleType());
+                break;
+            case TypeTag::VOID:
+                types.push_back(new ir::type::IRVoidType());
+                break;
+            case TypeTag::ARRAY:
+                {
+                    auto* base = checkIndex(types, in.uleb(), "type");
+                    types.push_back(makeArrayType(base, in.uleb()));
+                    break;
+                }
+            case TypeTag::POINTER:
+                types.push_back(new ir::type::IRPointerType(checkIndex(types, in.uleb(), "type")));
+                break;
+            case TypeTag::STRUCTURE:
+                types.push_back(new ir::type::IRStructureType(checkIndex(structures, in.uleb(), "structure")));
+                break;
+            case TypeTag::FUNCTION_REFERENCE:
+                {
+                    auto* returnType = checkIndex(types, in.uleb(), "type");
+                    decltype(ir::type::IRFunctionReferenceType::parameterTypes) parameterTypes;
+                    const auto parameterCount = in.uleb();
+                    for (uint64_t j = 0; j < parameterCount; ++j)
+                        parameterTypes.push_back(checkIndex(types, in.uleb(), "type"));
+                    const bool isVarArg = in.byte() != 0;
+                    types.push_back(new ir::type::IRFunctionReferenceType(returnType, std::move(parameterTypes),
+                                                                          isVarArg));
+                    break;
+                }
+            default:
+                throw std::runtime_error("unknown type tag in lg binary IR");
+            }
+        }
+    }
+
+    void BinaryIRModule::readFields()
+    {
+        Decoder in(getSection(BinaryIRSection::FIELDS));
+        if (in.uleb() != structures.size()) throw std::runtime_error("lg binary IR field table mismatch");
+        for (auto* structure : structures)
+        {
+            const auto count = in.uleb();
+            for (uint64_t i = 0; i < count; ++i)
+            {
+                auto name = readString(in, strings);
+                structure->fields.push_back(makeField(checkIndex(types, in.uleb(), "type"), std::move(name)));
+            }
+        }
+    }
+
+    void BinaryIRModule::readFunctions()
+    {
+        Decoder in(getSection(BinaryIRSection::FUNCTIONS));
+        const auto count = in.uleb();
+        functions.reserve(count);
+        functionTable.reserve(count);
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            auto name = readString(in, strings);
+            std::vector<std::string> attributes(in.uleb());
+            for (auto& attribute : attributes) attribute = readString(in, strings);
+            const bool isExtern = in.byte() != 0;
+            const bool isVarArg = in.byte() != 0;
+            auto* returnType = checkIndex(types, in.uleb(), "type");
+            std::vector<ir::function::IRLocalVariable*> args(in.uleb());
+            for (auto& arg : args)
+            {
+                auto argName = readString(in, strings);
+                arg = makeLocalVariable(checkIndex(types, in.uleb(), "type"), std::move(argName));
+            }
+            auto* function = makeFunction(std::move(attributes), returnType, std::move(name), args, isVarArg,
+                                          isExtern);
+            std::vector<ir::function::IRLocalVariable*> variables = args;
+            const auto localCount = in.uleb();
+            for (uint64_t j = 0; j < localCount; ++j)
+            {
+                auto localName = readString(in, strings);
+                function->locals.push_back(makeLocalVariable(checkIndex(types, in.uleb(), "type"),
+                                                             std::move(localName)));
+                variables.push_back(function->locals.back());
+            }
+            const auto bodyOffset = in.uleb();
+            const auto bodySize = in.uleb();
+            functionIndices[function] = functions.size();
+            functions.push_back({function, std::move(variables), bodyOffset, bodySize, isExtern});
+            functionTable.push_back(function);
+            addFunction(module, function);
+        }
+    }
+
+    void BinaryIRModule::readGlobals()
+    {
+        Decoder in(getSection(BinaryIRSection::GLOBALS));
+        const auto count = in.uleb();
+        globals.reserve(count);
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            auto name = readString(in, strings);
+            std::vector<std::string> attributes(in.uleb());
+            for (auto& attribute : attributes) attribute = readString(in, strings);
+            const bool isConstant = in.byte() != 0;
+            auto* type = checkIndex(types, in.uleb(), "type");
+            globals.push_back(makeGlobalVariable(std::move(attributes), isConstant, std::move(name), type));
+            addGlobalVariable(module, globals.back());
+        }
+        const std::vector<ir::function::IRLocalVariable*> noVariables;
+        BodyReader reader(in, strings, types, functionTable, globals, noVariables);
+        for (auto* global : globals) global->initializer = reader.operand();
+    }
+
+    void BinaryIRModule::loadFunction(ir::function::IRFunction* function)
+    {
+        const auto it = functionIndices.find(function);
+        if (it == functionIndices.end()) throw std::runtime_error(function->name + " is not part of this module");
+        loadFunction(functions[it->second]);
+    }
+
+    void BinaryIRModule::loadFunction(FunctionEntry& entry)
+    {
+        if (entry.loaded) return;
+        const auto bodies = getSection(BinaryIRSection::BODIES);
+        if (entry.bodyOffset > bodies.size() || entry.bodySize > bodies.size() - entry.bodyOffset)
+            throw std::runtime_error("body of " + entry.function->name + " is out of bounds");
+        Decoder in(bodies.substr(entry.bodyOffset, entry.bodySize));
+        BodyReader(in, strings, types, functionTable, globals, entry.variables).readBody(entry.function);
+        entry.loaded = true;
+    }
+
+    void BinaryIRModule::loadAllFunctions()
+    {
+        for (auto& entry : functions) loadFunction(entry);
+    }
+}
@@ -0,0 +1,121 @@
+#include <llvm_ir_gen.h>
+
+#include <llvm/IR/Intrinsics.h>
+
+namespace lg::llvm_ir_gen
+{
+    namespace
+    {
+        void checkArgumentCount(const std::string& name, const std::vector<llvm::Value*>& args, size_t count)
+        {
+            if (args.size() != count)
+                throw std::runtime_error(name + " expects " + std::to_string(count) + " arguments");
+        }
+    }
+
+    // Calls to well-known extern functions are lowered to LLVM intrinsics instead of real calls.
+    llvm::Value* LLVMIRGenerator::lowerBuiltin(ir::function::IRFunction* irFunction,
+                                               const std::vector<llvm::Value*>& args)
+    {
+        if (!irFunction->isExtern) return nullptr;
+        const auto& name = irFunction->name;
+        auto* returnType = llvmModule->getFunction(name)->getReturnType();
+        auto toReturnType = [this, returnType](llvm::Value* value) -> llvm::Value*
+        {
+            if (returnType->isVoidTy() || value->getType() == returnType) return value;
+            return builder->CreateIntCast(value, returnType, false);
+        };
+
+        if (name == "__builtin_expect")
+        {
+            checkArgumentCount(name, args, 2);
+            auto* type = args[0]->getType();
+            return toReturnType(builder->CreateIntrinsic(llvm::Intrinsic::expect, {type},
+                                                         {args[0], builder->CreateIntCast(args[1], type, false)}));
+        }
+        if (name == "__builtin_expect_with_probability")
+        {
+            checkArgumentCount(name, args, 3);
+            auto* type = args[0]->getType();
+            auto* probability = llvm::dyn_cast<llvm::ConstantFP>(args[2]);
+            if (probability == nullptr) throw std::runtime_error(name + " expects a constant probability");
+            auto value = probability->getValueAPF();
+            bool losesInfo;
+            value.convert(llvm::APFloat::IEEEdouble(), llvm::APFloat::rmNearestTiesToEven, &losesInfo);
+            return toReturnType(builder->CreateIntrinsic(llvm::Intrinsic::expect_with_probability, {type},
+                                                         {
+                                                             args[0], builder->CreateIntCast(args[1], type, false),
+                                                             llvm::ConstantFP::get(*context, value)
+                                                         }));
+        }
+        if (name == "__builtin_memcpy" || name == "__builtin_memmove")
+        {
+            checkArgumentCount(name, args, 3);
+            if (name == "__builtin_memcpy")
+                builder->CreateMemCpy(args[0], llvm::MaybeAlign(), args[1], llvm::MaybeAlign(), args[2]);
+            else
+                builder->CreateMemMove(args[0], llvm::MaybeAlign(), args[1], llvm::MaybeAlign(), args[2]);
+            return args[0];
+        }
+        if (name == "__builtin_memset")
+        {
+            checkArgumentCount(name, args, 3);
+            builder->CreateMemSet(args[0], builder->CreateIntCast(args[1], builder->getInt8Ty(), false), args[2],
+                                  llvm::MaybeAlign());
+            return args[0];
+        }
+
+        static const std::unordered_map<std::string, llvm::Intrinsic::ID> unaryIntrinsics = {
+            {"__builtin_popcount", llvm::Intrinsic::ctpop},
+            {"__builtin_bswap", llvm::Intrinsic::bswap},
+            {"__builtin_bitreverse", llvm::Intrinsic::bitreverse},
+        };
+        if (const auto it = unaryIntrinsics.find(name); it != unaryIntrinsics.end())
+        {
+            checkArgumentCount(name, args, 1);
+            return toReturnType(builder->CreateUnaryIntrinsic(it->second, args[0]));
+        }
+
+        static const std::unordered_map<std::string, llvm::Intrinsic::ID> countIntrinsics = {
+            {"__builtin_clz", llvm::Intrinsic::ctlz},
+            {"__builtin_ctz", llvm::Intrinsic::cttz},
+        };
+        if (const auto it = countIntrinsics.find(name); it != countIntrinsics.end())
+        {
+            checkArgumentCount(name, args, 1);
+            return toReturnType(builder->CreateIntrinsic(it->second, {args[0]->getType()},
+                                                         {args[0], builder->getFalse()}));
+        }
+
+        static const std::unordered_map<std::string, llvm::Intrinsic::ID> rotateIntrinsics = {
+            {"__builtin_rotl", llvm::Intrinsic::fshl},
+            {"__builtin_rotr", llvm::Intrinsic::fshr},
+        };
+        if (const auto it = rotateIntrinsics.find(name); it != rotateIntrinsics.end())
+        {
+            checkArgumentCount(name, args, 2);
+            auto* type = args[0]->getType();
+            return toReturnType(builder->CreateIntrinsic(it->second, {type},
+                                                         {
+                                                             args[0], args[0],
+                                                             builder->CreateIntCast(args[1], type, false)
+                                                         }));
+        }
+
+        static const std::unordered_map<std::string, llvm::Intrinsic::ID> funnelShiftIntrinsics = {
+            {"__builtin_fshl", llvm::Intrinsic::fshl},
+            {"__builtin_fshr", llvm::Intrinsic::fshr},
+        };
+        if (const auto it = funnelShiftIntrinsics.find(name); it != funnelShiftIntrinsics.end())
+        {
+            checkArgumentCount(name, args, 3);
+            auto* type = args[0]->getType();
+            return toReturnType(builder->CreateIntrinsic(it->second, {type},
+                                                         {
+                                                             args[0], builder->CreateIntCast(args[1], type, false),
+                                                             builder->CreateIntCast(args[2], type, false)
+                                                         }));
+        }
+        return nullptr;
+    }
+}
@@ -0,0 +1,238 @@
+#include <codegen.h>
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/CodeGen.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/PGOOptions.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/VirtualFileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/TargetParser/Host.h>
+#include <llvm/Transforms/IPO/Internalize.h>
+
+#include <algorithm>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace lg::llvm_ir_gen
+{
+    namespace
+    {
+        constexpr const char* TARGET_METADATA = "lg.target";
+    }
+
+    void initializeTargets()
+    {
+        static std::once_flag once;
+        std::call_once(once, []
+        {
+            llvm::InitializeAllTargetInfos();
+            llvm::InitializeAllTargets();
+            llvm::InitializeAllTargetMCs();
+            llvm::InitializeAllAsmParsers();
+            llvm::InitializeAllAsmPrinters();
+        });
+    }
+
+    llvm::OptimizationLevel toOptimizationLevel(unsigned optLevel)
+    {
+        switch (optLevel)
+        {
+        case 0:
+            return llvm::OptimizationLevel::O0;
+        case 1:
+            return llvm::OptimizationLevel::O1;
+        case 2:
+            return llvm::OptimizationLevel::O2;
+        default:
+            return llvm::OptimizationLevel::O3;
+        }
+    }
+
+    std::unique_ptr<llvm::TargetMachine> createTargetMachine(const std::string& triple, const std::string& cpu,
+                                                             const std::string& features, unsigned optLevel)
+    {
+        initializeTargets();
+        std::string error;
+        const auto* target = llvm::TargetRegistry::lookupTarget(triple, error);
+        if (target == nullptr) throw std::runtime_error("Failed to find target " + triple + ": " + error);
+        const auto codeGenOptLevel = llvm::CodeGenOpt::getLevel(static_cast<int>(std::min(optLevel, 3u)));
+        llvm::TargetOptions targetOptions;
+        return std::unique_ptr<llvm::TargetMachine>(target->createTargetMachine(
+            llvm::Triple(triple),
+            cpu,
+            features,
+            targetOptions,
+            llvm::Reloc::PIC_,
+            std::nullopt,
+            codeGenOptLevel.value_or(llvm::CodeGenOptLevel::Default)
+        ));
+    }
+
+    std::string resolveCPU(const std::string& cpu)
+    {
+        if (cpu == "native") return llvm::sys::getHostCPUName().str();
+        return cpu;
+    }
+
+    std::string resolveFeatures(const std::string& cpu, const std::string& features)
+    {
+        if (cpu != "native") return features;
+        const auto hostFeatures = llvm::sys::getHostCPUFeatures();
+        std::vector<std::string> flags;
+        for (const auto& feature : hostFeatures)
+        {
+            flags.push_back((feature.getValue() ? "+" : "-") + feature.getKey().str());
+        }
+        std::ranges::sort(flags);
+        if (!features.empty()) flags.push_back(features);
+        return llvm::join(flags, ",");
+    }
+
+    void configureModule(llvm::Module* module, const CompileOptions& options)
+    {
+        const auto cpu = resolveCPU(options.cpu);
+        const auto features = resolveFeatures(options.cpu, options.features);
+        const auto targetMachine = createTargetMachine(options.triple, cpu, features, options.optLevel);
+        module->setTargetTriple(llvm::Triple(options.triple));
+        module->setDataLayout(targetMachine->createDataLayout());
+
+        auto& context = module->getContext();
+        auto* target = module->getOrInsertNamedMetadata(TARGET_METADATA);
+        target->clearOperands();
+        target->addOperand(llvm::MDNode::get(context, {llvm::MDString::get(context, cpu),
+                                                       llvm::MDString::get(context, features)}));
+    }
+
+    ModuleTarget getModuleTarget(const llvm::Module* module)
+    {
+        const auto* target = module->getNamedMetadata(TARGET_METADATA);
+        if (target == nullptr || target->getNumOperands() != 1) return {};
+        const auto* node = target->getOperand(0);
+        const auto operand = [node](unsigned i)
+        {
+            const auto* value = llvm::dyn_cast<llvm::MDString>(node->getOperand(i));
+            return value == nullptr ? std::string() : value->getString().str();
+        };
+        return {operand(0), operand(1)};
+    }
+
+    std::unique_ptr<llvm::TargetMachine> prepareModule(llvm::Module* module, const CompileOptions& options)
+    {
+        auto targetMachine = createTargetMachine(options.triple, resolveCPU(options.cpu),
+                                                 resolveFeatures(options.cpu, options.features),
+                                                 options.optimizeForSize
+                                                     ? std::max(options.optLevel, 2u)
+                                                     : options.optLevel);
+        module->setTargetTriple(llvm::Triple(options.triple));
+        module->setDataLayout(targetMachine->createDataLayout());
+        if (options.optimizeForSize) applySizeProfile(module, targetMachine.get(), options.exportedSymbols);
+        return targetMachine;
+    }
+
+    std::vector<std::string> definedFunctionNames(const llvm::Module* module)
+    {
+        std::vector<std::string> functions;
+        for (const auto& function : *module)
+            if (!function.isDeclaration()) functions.push_back(function.getName().str());
+        return functions;
+    }
+
+    LinkOptions toLinkOptions(const CompileOptions& options)
+    {
+        return {options.linker, options.triple, options.pgo == PGOMode::INSTRUMENT, options.optimizeForSize};
+    }
+
+    void applySizeProfile(llvm::Module* module, llvm::TargetMachine* targetMachine,
+                          const std::vector<std::string>& exportedSymbols)
+    {
+        targetMachine->Options.FunctionSections = true;
+        targetMachine->Options.DataSections = true;
+        const std::unordered_set<std::string> exported(exportedSymbols.begin(), exportedSymbols.end());
+        llvm::internalizeModule(*module, [&exported](const llvm::GlobalValue& value)
+        {
+            return exported.contains(value.getName().str());
+        });
+        for (auto& function : *module)
+        {
+            if (function.isDeclaration()) continue;
+            function.addFnAttr(llvm::Attribute::OptimizeForSize);
+            function.addFnAttr(llvm::Attribute::MinSize);
+            if (function.hasLocalLinkage()) function.setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+        }
+        // Local unnamed_addr constants are what the backend places in mergeable sections.
+        for (auto& global : module->globals())
+        {
+            if (global.isConstant() && global.hasLocalLinkage() && !global.hasSection())
+                global.setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+        }
+    }
+
+    void optimize(llvm::Module* module, llvm::TargetMachine* targetMachine, const CompileOptions& options)
+    {
+        std::optional<llvm::PGOOptions> pgoOptions;
+        switch (options.pgo)
+        {
+        case PGOMode::NONE:
+            break;
+        case PGOMode::INSTRUMENT:
+            pgoOptions = llvm::PGOOptions(options.profilePath, "", "", "", llvm::vfs::getRealFileSystem(),
+                                          llvm::PGOOptions::IRInstr);
+            break;
+        case PGOMode::USE:
+            if (!llvm::sys::fs::exists(options.profilePath))
+                throw std::runtime_error("Profile data not found: " + options.profilePath);
+            // Functions are matched by their lg name and checked against the profile's CFG hash;
+            // the use pass then attaches branch weights and marks hot and cold functions.
+            pgoOptions = llvm::PGOOptions(options.profilePath, "", "", "", llvm::vfs::getRealFileSystem(),
+                                          llvm::PGOOptions::IRUse);
+            break;
+        default:
+            throw std::runtime_error("unsupported PGO mode");
+        }
+        if (options.optLevel == 0 && !options.optimizeForSize && !pgoOptions) return;
+
+        llvm::LoopAnalysisManager LAM;
+        llvm::FunctionAnalysisManager FAM;
+        llvm::CGSCCAnalysisManager CGAM;
+        llvm::ModuleAnalysisManager MAM;
+        llvm::PassInstrumentationCallbacks instrumentation;
+        if (options.shouldRunPass)
+        {
+            instrumentation.registerShouldRunOptionalPassCallback([&options](llvm::StringRef pass, llvm::Any)
+            {
+                return options.shouldRunPass(pass);
+            });
+        }
+        llvm::PassBuilder passBuilder(targetMachine, llvm::PipelineTuningOptions(), pgoOptions, &instrumentation);
+        passBuilder.registerModuleAnalyses(MAM);
+        passBuilder.registerCGSCCAnalyses(CGAM);
+        passBuilder.registerFunctionAnalyses(FAM);
+        passBuilder.registerLoopAnalyses(LAM);
+        passBuilder.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+        llvm::ModulePassManager MPM = options.optimizeForSize
+                                          ? passBuilder.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::Oz)
+                                          : options.optLevel == 0
+                                          ? passBuilder.buildO0DefaultPipeline(llvm::OptimizationLevel::O0)
+                                          : passBuilder.buildPerModuleDefaultPipeline(
+                                              toOptimizationLevel(options.optLevel));
+        MPM.run(*module, MAM);
+    }
+
+    void emitObject(llvm::Module* module, llvm::TargetMachine* targetMachine, llvm::SmallVectorImpl<char>& object)
+    {
+        llvm::raw_svector_ostream out(object);
+        llvm::legacy::PassManager passManager;
+        if (targetMachine->addPassesToEmitFile(passManager, out, nullptr, llvm::CodeGenFileType::ObjectFile))
+        {
+            throw std::runtime_error("Target " + targetMachine->getTargetTriple().str() + " cannot emit object files");
+        }
+        passManager.run(*module);
+    }
+}
@@ -0,0 +1,186 @@
+#include <llvm_ir_gen.h>
+
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
+
+namespace lg::llvm_ir_gen
+{
+    namespace
+    {
+        constexpr const char* COUNTER_SECTION = "lg_counters";
+        constexpr const char* COUNTER_FILE_VARIABLE = "LG_COUNTERS_FILE";
+        constexpr const char* DEFAULT_COUNTER_FILE = "lg_counters.txt";
+        constexpr const char* DUMP_FUNCTION = "__lg_counters_dump";
+        constexpr const char* DUMP_REQUEST = "__lg_counters_dump_requested";
+
+        // Declared by the first instrumented function and defined by emitCounterRuntime.
+        llvm::Function* getDumpFunction(llvm::Module* module)
+        {
+            if (auto* dump = module->getFunction(DUMP_FUNCTION)) return dump;
+            return llvm::Function::Create(llvm::FunctionType::get(llvm::Type::getVoidTy(module->getContext()), false),
+                                          llvm::GlobalValue::InternalLinkage, DUMP_FUNCTION, module);
+        }
+
+        // The sig_atomic_t the SIGUSR1 handler sets; 32 bits on every supported target.
+        llvm::GlobalVariable* getDumpRequest(llvm::Module* module)
+        {
+            if (auto* request = module->getNamedGlobal(DUMP_REQUEST)) return request;
+            auto* int32Type = llvm::Type::getInt32Ty(module->getContext());
+            return new llvm::GlobalVariable(*module, int32Type, false, llvm::GlobalValue::InternalLinkage,
+                                            llvm::ConstantInt::get(int32Type, 0), DUMP_REQUEST);
+        }
+    }
+
+    void LLVMIRGenerator::emitCounterIncrement(const std::string& name)
+    {
+        auto* int64Type = builder->getInt64Ty();
+        auto* counter = new llvm::GlobalVariable(
+            *llvmModule,
+            int64Type,
+            false,
+            llvm::GlobalValue::PrivateLinkage,
+            llvm::ConstantInt::get(int64Type, 0),
+            "__lg_counter." + name
+        );
+        counter->setSection(COUNTER_SECTION);
+        counter->setAlignment(llvm::Align(8));
+        // A relaxed load, add and store rather than an atomicrmw: the locked add made call-heavy code several
+        // times slower. Increments racing on another thread can be lost, which a hotness profile tolerates.
+        auto* value = builder->CreateAlignedLoad(int64Type, counter, llvm::MaybeAlign(8));
+        value->setAtomic(llvm::AtomicOrdering::Monotonic);
+        auto* store = builder->CreateAlignedStore(builder->CreateAdd(value, builder->getInt64(1)), counter,
+                                                  llvm::MaybeAlign(8));
+        store->setAtomic(llvm::AtomicOrdering::Monotonic);
+        counters.emplace_back(name, counter);
+    }
+
+    // Checks whether SIGUSR1 asked for a dump and, if so, writes it from here rather than from the handler,
+    // where stdio is not async-signal-safe. The common path is a volatile load and a branch that is almost
+    // never taken. New blocks go before next so the fall-through order of the lg blocks is unchanged, and the
+    // builder is left in the block that continues to next.
+    void LLVMIRGenerator::emitCounterDumpCheck(llvm::BasicBlock* next)
+    {
+        auto* request = getDumpRequest(llvmModule);
+        auto* dumpBlock = llvm::BasicBlock::Create(*context, "counters_dump", currentFunction, next);
+        auto* claimedBlock = llvm::BasicBlock::Create(*context, "counters_dump_claimed", currentFunction, next);
+        auto* continueBlock = llvm::BasicBlock::Create(*context, "counters_continue", currentFunction, next);
+
+        auto* requested = builder->CreateLoad(builder->getInt32Ty(), request, true);
+        builder->CreateCondBr(builder->CreateIsNotNull(requested), dumpBlock, continueBlock,
+                              llvm::MDBuilder(*context).createUnlikelyBranchWeights());
+
+        // Only the thread that clears the flag dumps, so one signal gives one dump.
+        builder->SetInsertPoint(dumpBlock);
+        auto* previous = builder->CreateAtomicRMW(llvm::AtomicRMWInst::Xchg, request, builder->getInt32(0),
+                                                  llvm::MaybeAlign(4), llvm::AtomicOrdering::Monotonic);
+        builder->CreateCondBr(builder->CreateIsNotNull(previous), claimedBlock, continueBlock);
+
+        builder->SetInsertPoint(claimedBlock);
+        builder->CreateCall(getDumpFunction(llvmModule));
+        builder->CreateBr(continueBlock);
+
+        builder->SetInsertPoint(continueBlock);
+    }
+
+    // Emits a per-module table of counter names and addresses, a dump function that appends
+    // "<name> <count>" lines to $LG_COUNTERS_FILE (default lg_counters.txt), and a constructor that
+    // runs the dump at exit and installs the SIGUSR1 handler. The handler only sets the dump request flag;
+    // the dump itself happens at the next instrumented function entry (see emitCounterDumpCheck).
+    void LLVMIRGenerator::emitCounterRuntime()
+    {
+        llvm::IRBuilder<> runtimeBuilder(*context);
+        auto* ptrType = runtimeBuilder.getPtrTy();
+        auto* int32Type = runtimeBuilder.getInt32Ty();
+        auto* int64Type = runtimeBuilder.getInt64Ty();
+        auto* voidType = runtimeBuilder.getVoidTy();
+
+        std::vector<llvm::Constant*> names;
+        std::vector<llvm::Constant*> values;
+        for (const auto& [name, counter] : counters)
+        {
+            names.push_back(runtimeBuilder.CreateGlobalString(name, "__lg_counter_name", 0, llvmModule));
+            values.push_back(counter);
+        }
+        auto* tableType = llvm::ArrayType::get(ptrType, counters.size());
+        auto* nameTable = new llvm::GlobalVariable(*llvmModule, tableType, true, llvm::GlobalValue::PrivateLinkage,
+                                                   llvm::ConstantArray::get(tableType, names), "__lg_counter_names");
+        auto* valueTable = new llvm::GlobalVariable(*llvmModule, tableType, true, llvm::GlobalValue::PrivateLinkage,
+                                                    llvm::ConstantArray::get(tableType, values),
+                                                    "__lg_counter_values");
+
+        const auto getenvFunction = llvmModule->getOrInsertFunction(
+            "getenv", llvm::FunctionType::get(ptrType, {ptrType}, false));
+        const auto fopenFunction = llvmModule->getOrInsertFunction(
+            "fopen", llvm::FunctionType::get(ptrType, {ptrType, ptrType}, false));
+        const auto fprintfFunction = llvmModule->getOrInsertFunction(
+            "fprintf", llvm::FunctionType::get(int32Type, {ptrType, ptrType}, true));
+        const auto fcloseFunction = llvmModule->getOrInsertFunction(
+            "fclose", llvm::FunctionType::get(int32Type, {ptrType}, false));
+        const auto atexitFunction = llvmModule->getOrInsertFunction(
+            "atexit", llvm::FunctionType::get(int32Type, {ptrType}, false));
+        const auto signalFunction = llvmModule->getOrInsertFunction(
+            "signal", llvm::FunctionType::get(ptrType, {int32Type, ptrType}, false));
+
+        auto* dump = getDumpFunction(llvmModule);
+        auto* entry = llvm::BasicBlock::Create(*context, "entry", dump);
+        auto* loop = llvm::BasicBlock::Create(*context, "loop", dump);
+        auto* done = llvm::BasicBlock::Create(*context, "done", dump);
+        auto* exit = llvm::BasicBlock::Create(*context, "exit", dump);
+
+        runtimeBuilder.SetInsertPoint(entry);
+        auto* configuredPath = runtimeBuilder.CreateCall(getenvFunction,
+                                                         {
+                                                             runtimeBuilder.CreateGlobalString(
+                                                                 COUNTER_FILE_VARIABLE, "", 0, llvmModule)
+                                                         });
+        auto* path = runtimeBuilder.CreateSelect(runtimeBuilder.CreateIsNull(configuredPath),
+                                                 runtimeBuilder.CreateGlobalString(
+                                                     DEFAULT_COUNTER_FILE, "", 0, llvmModule),
+                                                 configuredPath);
+        auto* file = runtimeBuilder.CreateCall(fopenFunction,
+                                               {path, runtimeBuilder.CreateGlobalString("a", "", 0, llvmModule)});
+        runtimeBuilder.CreateCondBr(runtimeBuilder.CreateIsNull(file), exit, loop);
+
+        runtimeBuilder.SetInsertPoint(loop);
+        auto* index = runtimeBuilder.CreatePHI(int64Type, 2);
+        index->addIncoming(runtimeBuilder.getInt64(0), entry);
+        auto* name = runtimeBuilder.CreateLoad(
+            ptrType, runtimeBuilder.CreateInBoundsGEP(tableType, nameTable, {runtimeBuilder.getInt64(0), index}));
+        auto* counter = runtimeBuilder.CreateLoad(
+            ptrType, runtimeBuilder.CreateInBoundsGEP(tableType, valueTable, {runtimeBuilder.getInt64(0), index}));
+        auto* value = runtimeBuilder.CreateAlignedLoad(int64Type, counter, llvm::MaybeAlign(8));
+        value->setAtomic(llvm::AtomicOrdering::Monotonic);
+        runtimeBuilder.CreateCall(fprintfFunction,
+                                  {
+                                      file, runtimeBuilder.CreateGlobalString("%s %llu\n", "", 0, llvmModule), name,
+                                      value
+                                  });
+        auto* next = runtimeBuilder.CreateAdd(index, runtimeBuilder.getInt64(1));
+        index->addIncoming(next, loop);
+        runtimeBuilder.CreateCondBr(runtimeBuilder.CreateICmpULT(next, runtimeBuilder.getInt64(counters.size())),
+                                    loop, done);
+
+        runtimeBuilder.SetInsertPoint(done);
+        runtimeBuilder.CreateCall(fcloseFunction, {file});
+        runtimeBuilder.CreateBr(exit);
+
+        runtimeBuilder.SetInsertPoint(exit);
+        runtimeBuilder.CreateRetVoid();
+
+        auto* signalHandler = llvm::Function::Create(llvm::FunctionType::get(voidType, {int32Type}, false),
+                                                     llvm::GlobalValue::InternalLinkage, "__lg_counters_signal",
+                                                     llvmModule);
+        runtimeBuilder.SetInsertPoint(llvm::BasicBlock::Create(*context, "entry", signalHandler));
+        runtimeBuilder.CreateStore(runtimeBuilder.getInt32(1), getDumpRequest(llvmModule), true);
+        runtimeBuilder.CreateRetVoid();
+
+        auto* init = llvm::Function::Create(llvm::FunctionType::get(voidType, false),
+                                            llvm::GlobalValue::InternalLinkage, "__lg_counters_init", llvmModule);
+        runtimeBuilder.SetInsertPoint(llvm::BasicBlock::Create(*context, "entry", init));
+        runtimeBuilder.CreateCall(atexitFunction, {dump});
+        const int sigusr1 = llvmModule->getTargetTriple().isOSDarwin() ? 30 : 10;
+        runtimeBuilder.CreateCall(signalFunction, {runtimeBuilder.getInt32(sigusr1), signalHandler});
+        runtimeBuilder.CreateRetVoid();
+        llvm::appendToGlobalCtors(*llvmModule, init, 65535);
+    }
+}
@@ -0,0 +1,174 @@
+#include <ir_construction.h>
+
+namespace lg::llvm_ir_gen
+{
+    using namespace construction;
+
+    namespace
+    {
+        using Operand = std::remove_pointer_t<decltype(ir::instruction::IRStore::value)>;
+        using Block = ir::base::IRBasicBlock;
+        using Condition = ir::base::IRCondition;
+
+        template <typename T, typename... Args>
+        constexpr bool constructible = std::is_constructible_v<T, Args...>;
+
+        // The signatures lg-cpp is assumed to provide, in the order the lg parser passes arguments. Members that
+        // the generator already reads (names, types, fields, _unsigned, size, base, cfg, locals, initializer) are
+        // not listed; everything below is only written, so a mismatch shows up here first rather than as an
+        // overload error deep inside the loader.
+        static_assert(constructible<ir::structure::IRStructure, std::vector<std::string>, std::string>);
+        static_assert(constructible<Field, Type*, std::string>);
+        static_assert(constructible<ir::base::IRGlobalVariable, std::vector<std::string>, bool, std::string, Type*>);
+        static_assert(constructible<ir::function::IRLocalVariable, Type*, std::string>);
+        static_assert(constructible<ir::function::IRFunction, std::vector<std::string>, Type*, std::string,
+                                    std::vector<ir::function::IRLocalVariable*>, bool>);
+        static_assert(constructible<Block, std::string>);
+        static_assert(constructible<Register, std::string>);
+        static_assert(requires(ControlFlowGraph* cfg, Block* block) { cfg->addBasicBlock(block); });
+        static_assert(requires(ir::IRModule* module, ir::structure::IRStructure* structure,
+                               ir::function::IRFunction* function, ir::base::IRGlobalVariable* global)
+        {
+            module->putStructure(structure);
+            module->putFunction(function);
+            module->putGlobalVariable(global);
+        });
+
+        static_assert(constructible<ir::type::IRFloatType> && constructible<ir::type::IRDoubleType> &&
+                      constructible<ir::type::IRVoidType>);
+        static_assert(constructible<ir::type::IRIntegerType, decltype(ir::type::IRIntegerType::size), bool>);
+        static_assert(constructible<ir::type::IRArrayType, Type*, uint64_t>);
+        static_assert(constructible<ir::type::IRPointerType, Type*>);
+        static_assert(constructible<ir::type::IRStructureType, ir::structure::IRStructure*>);
+        static_assert(constructible<ir::type::IRFunctionReferenceType, Type*,
+                                    decltype(ir::type::IRFunctionReferenceType::parameterTypes), bool>);
+
+        static_assert(constructible<ir::value::constant::IRIntegerConstant, ir::type::IRIntegerType*,
+                                    decltype(ir::value::constant::IRIntegerConstant::value)>);
+        static_assert(constructible<ir::value::constant::IRArrayConstant, ir::type::IRArrayType*,
+                                    decltype(ir::value::constant::IRArrayConstant::elements)>);
+        static_assert(constructible<ir::value::constant::IRStructureInitializer, ir::type::IRStructureType*,
+                                    decltype(ir::value::constant::IRStructureInitializer::elements)>);
+        static_assert(constructible<ir::value::constant::IRFloatConstant, float>);
+        static_assert(constructible<ir::value::constant::IRDoubleConstant, double>);
+        static_assert(constructible<ir::value::constant::IRNullptrConstant>);
+        static_assert(constructible<ir::value::constant::IRStringConstant, std::string>);
+        static_assert(constructible<ir::value::constant::IRFunctionReference, ir::function::IRFunction*>);
+        static_assert(constructible<ir::value::constant::IRGlobalVariableReference, ir::base::IRGlobalVariable*>);
+        static_assert(constructible<ir::value::IRLocalVariableReference, ir::function::IRLocalVariable*>);
+
+        // The binary IR reader builds instructions directly from their operands.
+        static_assert(constructible<ir::instruction::IRAssembly, std::string, std::string,
+                                    decltype(ir::instruction::IRAssembly::operands)>);
+        static_assert(constructible<ir::instruction::IRBinaryOperates, ir::instruction::IRBinaryOperates::Operator,
+                                    Operand*, Operand*, Register*>);
+        static_assert(constructible<ir::instruction::IRUnaryOperates, ir::instruction::IRUnaryOperates::Operator,
+                                    Operand*, Register*>);
+        static_assert(constructible<ir::instruction::IRGetElementPointer, Operand*,
+                                    decltype(ir::instruction::IRGetElementPointer::indices), Register*>);
+        static_assert(constructible<ir::instruction::IRCompare, Condition, Operand*, Operand*, Register*>);
+        static_assert(constructible<ir::instruction::IRConditionalJump, Condition, Operand*, Operand*, Block*>);
+        static_assert(constructible<ir::instruction::IRGoto, Block*>);
+        static_assert(constructible<ir::instruction::IRInvoke, Type*, Operand*,
+                                    decltype(ir::instruction::IRInvoke::arguments), Register*>);
+        static_assert(constructible<ir::instruction::IRReturn, Operand*>);
+        static_assert(constructible<ir::instruction::IRLoad, Operand*, Register*>);
+        static_assert(constructible<ir::instruction::IRStore, Operand*, Operand*>);
+        static_assert(constructible<ir::instruction::IRNop>);
+        static_assert(constructible<ir::instruction::IRSetRegister, Register*, Operand*>);
+        static_assert(constructible<ir::instruction::IRStackAllocate, Type*, Operand*, Register*>);
+        static_assert(constructible<ir::instruction::IRTypeCast, ir::instruction::IRTypeCast::Kind,
+                                    Operand*, Type*, Register*>);
+        static_assert(constructible<ir::instruction::IRPhi, decltype(ir::instruction::IRPhi::values), Register*>);
+        static_assert(constructible<ir::instruction::IRSwitch, Operand*, Block*,
+                                    decltype(ir::instruction::IRSwitch::cases)>);
+    }
+
+    ir::IRModule* makeModule()
+    {
+        return new ir::IRModule();
+    }
+
+    ir::structure::IRStructure* makeStructure(std::vector<std::string> attributes, std::string name)
+    {
+        return new ir::structure::IRStructure(std::move(attributes), std::move(name));
+    }
+
+    Field* makeField(Type* type, std::string name)
+    {
+        return new Field(type, std::move(name));
+    }
+
+    ir::base::IRGlobalVariable* makeGlobalVariable(std::vector<std::string> attributes, bool isConstant,
+                                                   std::string name, Type* type)
+    {
+        return new ir::base::IRGlobalVariable(std::move(attributes), isConstant, std::move(name), type);
+    }
+
+    ir::function::IRLocalVariable* makeLocalVariable(Type* type, std::string name)
+    {
+        return new ir::function::IRLocalVariable(type, std::move(name));
+    }
+
+    ir::function::IRFunction* makeFunction(std::vector<std::string> attributes, Type* returnType, std::string name,
+                                           std::vector<ir::function::IRLocalVariable*> args, bool isVarArg,
+                                           bool isExtern)
+    {
+        auto* function = new ir::function::IRFunction(std::move(attributes), returnType, std::move(name),
+                                                      std::move(args), isVarArg);
+        function->isExtern = isExtern;
+        if (!isExtern) function->cfg = new ControlFlowGraph();
+        return function;
+    }
+
+    ir::base::IRBasicBlock* makeBasicBlock(ControlFlowGraph* cfg, std::string name)
+    {
+        auto* block = new ir::base::IRBasicBlock(std::move(name));
+        cfg->addBasicBlock(block);
+        return block;
+    }
+
+    Register* makeRegister(std::string name, Type* type)
+    {
+        auto* value = new Register(std::move(name));
+        value->type = type;
+        return value;
+    }
+
+    ir::type::IRIntegerType* makeIntegerType(uint64_t size, bool isUnsigned)
+    {
+        return new ir::type::IRIntegerType(static_cast<decltype(ir::type::IRIntegerType::size)>(size), isUnsigned);
+    }
+
+    ir::type::IRArrayType* makeArrayType(Type* base, uint64_t size)
+    {
+        return new ir::type::IRArrayType(base, size);
+    }
+
+    ir::value::constant::IRIntegerConstant* makeIntegerConstant(ir::type::IRIntegerType* type, int64_t value)
+    {
+        return new ir::value::constant::IRIntegerConstant(
+            type, static_cast<decltype(ir::value::constant::IRIntegerConstant::value)>(value));
+    }
+
+    ir::value::constant::IRArrayConstant* makeArrayConstant(
+        ir::type::IRArrayType* type, decltype(ir::value::constant::IRArrayConstant::elements) elements)
+    {
+        return new ir::value::constant::IRArrayConstant(type, std::move(elements));
+    }
+
+    void addStructure(ir::IRModule* module, ir::structure::IRStructure* structure)
+    {
+        module->putStructure(structure);
+    }
+
+    void addFunction(ir::IRModule* module, ir::function::IRFunction* function)
+    {
+        module->putFunction(function);
+    }
+
+    void addGlobalVariable(ir::IRModule* module, ir::base::IRGlobalVariable* global)
+    {
+        module->putGlobalVariable(global);
+    }
+}
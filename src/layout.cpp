@@ -0,0 +1,107 @@
+#include <layout.h>
+
+#include <llvm/Support/MathExtras.h>
+
+#include <algorithm>
+#include <numeric>
+
+namespace lg::llvm_ir_gen
+{
+    namespace
+    {
+        uint64_t layoutSize(const llvm::DataLayout& dataLayout, const std::vector<llvm::Type*>& fields,
+                            const std::vector<unsigned>& order)
+        {
+            uint64_t offset = 0;
+            uint64_t alignment = 1;
+            for (const auto index : order)
+            {
+                const auto fieldAlignment = dataLayout.getABITypeAlign(fields[index]).value();
+                offset = llvm::alignTo(offset, fieldAlignment) +
+                    dataLayout.getTypeAllocSize(fields[index]).getFixedValue();
+                alignment = std::max(alignment, fieldAlignment);
+            }
+            return llvm::alignTo(offset, alignment);
+        }
+    }
+
+    std::vector<unsigned> suggestFieldOrder(const llvm::DataLayout& dataLayout, const std::vector<llvm::Type*>& fields,
+                                            const std::vector<bool>& hot)
+    {
+        std::vector<unsigned> order(fields.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::ranges::stable_sort(order, [&](unsigned a, unsigned b)
+        {
+            if (hot[a] != hot[b]) return static_cast<bool>(hot[a]);
+            const auto alignmentA = dataLayout.getABITypeAlign(fields[a]);
+            const auto alignmentB = dataLayout.getABITypeAlign(fields[b]);
+            if (alignmentA != alignmentB) return alignmentA > alignmentB;
+            return dataLayout.getTypeAllocSize(fields[a]).getFixedValue() >
+                dataLayout.getTypeAllocSize(fields[b]).getFixedValue();
+        });
+        return order;
+    }
+
+    StructureLayout analyzeStructure(const llvm::DataLayout& dataLayout, llvm::StructType* structType,
+                                     const std::vector<std::string>& fieldNames, const std::vector<bool>& hot)
+    {
+        const auto* structLayout = dataLayout.getStructLayout(structType);
+        StructureLayout layout{
+            structType->getName().str(), structLayout->getSizeInBytes(), structLayout->getAlignment().value(), 0,
+            structType->isPacked(), false, {}, {}, 0
+        };
+
+        std::vector<llvm::Type*> fields(structType->element_begin(), structType->element_end());
+        uint64_t used = 0;
+        for (unsigned i = 0; i < fields.size(); ++i)
+        {
+            const auto offset = structLayout->getElementOffset(i).getFixedValue();
+            const auto size = dataLayout.getTypeAllocSize(fields[i]).getFixedValue();
+            std::string type;
+            llvm::raw_string_ostream typeOut(type);
+            fields[i]->print(typeOut);
+            layout.fields.push_back({
+                fieldNames[i], type, offset, size, dataLayout.getABITypeAlign(fields[i]).value(), hot[i],
+                size != 0 && offset / CACHE_LINE_SIZE != (offset + size - 1) / CACHE_LINE_SIZE
+            });
+            used += size;
+        }
+        layout.padding = layout.size - used;
+
+        if (layout.packed)
+        {
+            layout.suggestedOrder.resize(fields.size());
+            std::iota(layout.suggestedOrder.begin(), layout.suggestedOrder.end(), 0);
+            layout.suggestedSize = layout.size;
+            return layout;
+        }
+        layout.suggestedOrder = suggestFieldOrder(dataLayout, fields, hot);
+        layout.suggestedSize = layoutSize(dataLayout, fields, layout.suggestedOrder);
+        return layout;
+    }
+
+    void printLayoutReport(llvm::raw_ostream& out, const std::vector<StructureLayout>& layouts)
+    {
+        for (const auto& layout : layouts)
+        {
+            out << "structure " << layout.name << ": size " << layout.size << ", align " << layout.alignment
+                << ", padding " << layout.padding << (layout.packed ? ", packed" : "")
+                << (layout.reordered ? ", reordered" : "") << "\n";
+            for (const auto& field : layout.fields)
+            {
+                out << "  +" << field.offset << "\t" << field.name << "\t" << field.type << " (size " << field.size
+                    << ", align " << field.alignment << ")";
+                if (field.hot) out << " hot";
+                if (field.crossesCacheLine) out << " crosses cache line " << field.offset / CACHE_LINE_SIZE;
+                out << "\n";
+            }
+            if (!std::ranges::is_sorted(layout.suggestedOrder))
+            {
+                out << "  suggested order:";
+                for (const auto index : layout.suggestedOrder) out << " " << layout.fields[index].name;
+                out << " (size " << layout.suggestedSize << ", saves "
+                    << static_cast<int64_t>(layout.size) - static_cast<int64_t>(layout.suggestedSize) << " bytes)\n";
+            }
+        }
+    }
+}
@@ -0,0 +1,339 @@
+#include <linker.h>
+
+#include "clang/Driver/Driver.h"
+#include "clang/Driver/Compilation.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Frontend/TextDiagnosticPrinter.h"
+#include <clang/Basic/DiagnosticIDs.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/VersionTuple.h>
+#include <llvm/Support/WithColor.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/TargetParser/Triple.h>
+
+#ifdef LG_LLVM_IR_GEN_HAS_LLD
+#include <lld/Common/CommonLinkerContext.h>
+#include <lld/Common/Driver.h>
+#endif
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+
+namespace lg::llvm_ir_gen
+{
+    namespace
+    {
+        // Object files handed to a linker. On Linux they stay in memory behind memfd descriptors,
+        // elsewhere they are spilled to temporary files.
+        class ObjectFiles
+        {
+        public:
+            ObjectFiles(const std::vector<llvm::StringRef>& objects, bool inMemory)
+            {
+                for (const auto& object : objects)
+                {
+#ifdef __linux__
+                    if (inMemory && addInMemory(object)) continue;
+#endif
+                    addTemporary(object);
+                }
+            }
+
+            ObjectFiles(const ObjectFiles&) = delete;
+            ObjectFiles& operator=(const ObjectFiles&) = delete;
+
+            ~ObjectFiles()
+            {
+#ifdef __linux__
+                for (const int fd : descriptors) close(fd);
+#endif
+                for (const auto& temporary : temporaries)
+                {
+                    if (std::error_code ec = llvm::sys::fs::remove(temporary))
+                    {
+                        llvm::errs() << "Failed to remove file: " << ec.message() << "\n";
+                    }
+                }
+            }
+
+            [[nodiscard]] const std::vector<std::string>& getPaths() const
+            {
+                return paths;
+            }
+
+        private:
+            std::vector<std::string> paths;
+            std::vector<std::string> temporaries;
+            std::vector<int> descriptors;
+
+#ifdef __linux__
+            bool addInMemory(llvm::StringRef object)
+            {
+                const int fd = memfd_create("lg_object", MFD_CLOEXEC);
+                if (fd < 0) return false;
+                size_t written = 0;
+                while (written < object.size())
+                {
+                    const ssize_t n = write(fd, object.data() + written, object.size() - written);
+                    if (n <= 0)
+                    {
+                        close(fd);
+                        return false;
+                    }
+                    written += static_cast<size_t>(n);
+                }
+                descriptors.push_back(fd);
+                paths.push_back("/proc/self/fd/" + std::to_string(fd));
+                return true;
+            }
+#endif
+
+            void addTemporary(llvm::StringRef object)
+            {
+                llvm::SmallString<128> path;
+                if (std::error_code ec = llvm::sys::fs::createTemporaryFile("lg_object", "o", path))
+                {
+                    throw std::runtime_error("Failed to create temporary file: " + ec.message());
+                }
+                temporaries.push_back(path.str().str());
+                std::error_code EC;
+                llvm::raw_fd_ostream out(path, EC);
+                if (EC) throw std::runtime_error("Failed to open file: " + path.str().str());
+                out << object;
+                paths.push_back(path.str().str());
+            }
+        };
+
+#ifdef LG_LLVM_IR_GEN_HAS_LLD
+        struct GnuTarget
+        {
+            std::string emulation;
+            std::string dynamicLinker;
+            std::string multiarch;
+        };
+
+        GnuTarget getGnuTarget(const llvm::Triple& triple)
+        {
+            switch (triple.getArch())
+            {
+            case llvm::Triple::x86_64:
+                return {"elf_x86_64", "/lib64/ld-linux-x86-64.so.2", "x86_64-linux-gnu"};
+            case llvm::Triple::x86:
+                return {"elf_i386", "/lib/ld-linux.so.2", "i386-linux-gnu"};
+            case llvm::Triple::aarch64:
+                return {"aarch64linux", "/lib/ld-linux-aarch64.so.1", "aarch64-linux-gnu"};
+            case llvm::Triple::riscv64:
+                return {"elf64lriscv", "/lib/ld-linux-riscv64-lp64d.so.1", "riscv64-linux-gnu"};
+            default:
+                throw std::runtime_error("lld linking is not supported for " + triple.str());
+            }
+        }
+
+        std::optional<std::string> findFile(const std::vector<std::string>& dirs, llvm::StringRef name)
+        {
+            for (const auto& dir : dirs)
+            {
+                llvm::SmallString<128> path(dir);
+                llvm::sys::path::append(path, name);
+                if (llvm::sys::fs::exists(path)) return path.str().str();
+            }
+            return std::nullopt;
+        }
+
+        std::optional<std::string> findGccInstallation(const llvm::Triple& triple)
+        {
+            std::optional<std::string> best;
+            llvm::VersionTuple bestVersion;
+            for (const auto* base : {"/usr/lib/gcc", "/usr/lib64/gcc"})
+            {
+                std::error_code ec;
+                for (llvm::sys::fs::directory_iterator it(base, ec), end; it != end && !ec; it.increment(ec))
+                {
+                    if (!llvm::sys::path::filename(it->path()).starts_with(triple.getArchName())) continue;
+                    std::error_code versionEc;
+                    for (llvm::sys::fs::directory_iterator version(it->path(), versionEc), versionEnd;
+                         version != versionEnd && !versionEc; version.increment(versionEc))
+                    {
+                        llvm::VersionTuple tuple;
+                        if (tuple.tryParse(llvm::sys::path::filename(version->path()))) continue;
+                        if (!llvm::sys::fs::exists(version->path() + "/crtbeginS.o")) continue;
+                        if (!best || bestVersion < tuple)
+                        {
+                            best = version->path();
+                            bestVersion = tuple;
+                        }
+                    }
+                }
+            }
+            return best;
+        }
+
+        std::string findProfileRuntime(const llvm::Triple& triple)
+        {
+            const std::string resourceDir = LG_LLVM_IR_GEN_CLANG_RESOURCE_DIR;
+            const std::vector<std::string> candidates = {
+                resourceDir + "/lib/" + triple.str() + "/libclang_rt.profile.a",
+                resourceDir + "/lib/" + triple.getArchName().str() + "-unknown-linux-gnu/libclang_rt.profile.a",
+                resourceDir + "/lib/linux/libclang_rt.profile-" + triple.getArchName().str() + ".a"
+            };
+            for (const auto& candidate : candidates)
+            {
+                if (llvm::sys::fs::exists(candidate)) return candidate;
+            }
+            throw std::runtime_error("Failed to find the profile runtime in " + resourceDir);
+        }
+
+        void linkWithLLD(const std::vector<std::string>& objects, const LinkOptions& options,
+                         const std::string& output)
+        {
+            const llvm::Triple triple(options.triple);
+            const auto gnuTarget = getGnuTarget(triple);
+            const std::vector<std::string> libraryDirs = {
+                "/usr/lib/" + gnuTarget.multiarch, "/lib/" + gnuTarget.multiarch, "/usr/lib64", "/lib64", "/usr/lib",
+                "/lib"
+            };
+            const auto gccInstallation = findGccInstallation(triple);
+            auto require = [&libraryDirs](llvm::StringRef name)
+            {
+                auto path = findFile(libraryDirs, name);
+                if (!path) throw std::runtime_error("Failed to find " + name.str() + " for lld linking");
+                return *path;
+            };
+
+            std::vector<std::string> args = {
+                "ld.lld", "--eh-frame-hdr", "-m", gnuTarget.emulation, "-pie", "-dynamic-linker",
+                gnuTarget.dynamicLinker, "-o", output, require("Scrt1.o"), require("crti.o")
+            };
+            if (options.optimizeForSize) args.insert(args.end(), {"--gc-sections", "--icf=all"});
+            if (gccInstallation)
+            {
+                args.push_back(*gccInstallation + "/crtbeginS.o");
+                args.push_back("-L" + *gccInstallation);
+            }
+            for (const auto& dir : libraryDirs)
+            {
+                if (llvm::sys::fs::is_directory(dir)) args.push_back("-L" + dir);
+            }
+            args.insert(args.end(), objects.begin(), objects.end());
+            if (options.profileRuntime)
+            {
+                args.push_back(findProfileRuntime(triple));
+                args.emplace_back("-u__llvm_profile_runtime");
+            }
+            if (gccInstallation)
+            {
+                args.insert(args.end(), {"-lgcc", "--as-needed", "-lgcc_s", "--no-as-needed"});
+            }
+            args.emplace_back("-lc");
+            if (gccInstallation)
+            {
+                args.insert(args.end(), {"-lgcc", "--as-needed", "-lgcc_s", "--no-as-needed"});
+                args.push_back(*gccInstallation + "/crtendS.o");
+            }
+            args.push_back(require("crtn.o"));
+
+            std::vector<const char*> argsText;
+            for (const auto& arg : args)
+            {
+                argsText.push_back(arg.c_str());
+            }
+
+            // lld keeps its state in globals, so only one link may run at a time.
+            static std::mutex lldMutex;
+            std::lock_guard lock(lldMutex);
+            const bool linked = lld::elf::link(argsText, llvm::outs(), llvm::errs(), false, false);
+            lld::CommonLinkerContext::destroy();
+            if (!linked) throw std::runtime_error("lld failed to link " + output);
+        }
+#endif
+    }
+
+    bool runClangDriver(const std::vector<std::string>& inputs, const std::string& triple, const std::string& output)
+    {
+        clang::DiagnosticOptions DiagOpts;
+        llvm::IntrusiveRefCntPtr DiagID(new clang::DiagnosticIDs());
+        clang::DiagnosticsEngine Diags(DiagID, DiagOpts, new clang::TextDiagnosticPrinter(llvm::errs(), DiagOpts));
+
+        std::string ClangPath = "clang";
+        llvm::ErrorOr<std::string> ClangPathOrErr = llvm::sys::findProgramByName("clang");
+        if (ClangPathOrErr)
+        {
+            ClangPath = ClangPathOrErr.get();
+        }
+
+        clang::driver::Driver Driver(ClangPath, triple, Diags);
+
+        std::vector<std::string> args = {ClangPath};
+        args.insert(args.end(), inputs.begin(), inputs.end());
+
+        auto addArg = [&args](const std::string& flag, const std::string& value = "")
+        {
+            args.emplace_back(flag);
+            if (!value.empty())
+            {
+                args.emplace_back(value);
+            }
+        };
+
+        addArg("-o", output);
+
+        std::vector<const char*> argsText;
+        for (const auto& arg : args)
+        {
+            argsText.push_back(arg.c_str());
+        }
+        argsText.push_back(nullptr);
+
+        const auto C = Driver.BuildCompilation(argsText);
+        if (!C) return false;
+        llvm::SmallVector<std::pair<int, const clang::driver::Command*>, 4> Failing;
+        C->ExecuteJobs(C->getJobs(), Failing);
+        return Failing.empty();
+    }
+
+    void linkObjects(const std::vector<llvm::StringRef>& objects, const LinkOptions& options, const std::string& output)
+    {
+        switch (options.linker)
+        {
+        case LinkerKind::CLANG:
+            {
+                const ObjectFiles files(objects, false);
+                auto inputs = files.getPaths();
+                if (options.profileRuntime) inputs.emplace_back("-fprofile-generate");
+                if (options.optimizeForSize)
+                {
+                    inputs.emplace_back("-Wl,--gc-sections");
+                    if (llvm::sys::findProgramByName("ld.lld"))
+                        inputs.insert(inputs.end(), {"-fuse-ld=lld", "-Wl,--icf=all"});
+                    else
+                        llvm::WithColor::warning() << "ld.lld not found, linking " << output
+                            << " without identical code folding\n";
+                }
+                if (!runClangDriver(inputs, options.triple, output))
+                    throw std::runtime_error("Failed to link " + output);
+                break;
+            }
+        case LinkerKind::LLD:
+            {
+#ifdef LG_LLVM_IR_GEN_HAS_LLD
+                const ObjectFiles files(objects, true);
+                linkWithLLD(files.getPaths(), options, output);
+                break;
+#else
+                throw std::runtime_error("lld support is not built in");
+#endif
+            }
+        default:
+            throw std::runtime_error("unsupported linker");
+        }
+    }
+}
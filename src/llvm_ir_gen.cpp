@@ -3,12 +3,172 @@
 //
 
 #include <llvm_ir_gen.h>
+#include <attributes.h>
+#include <codegen.h>
+#include <remarks.h>
+#include <size_report.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <algorithm>
+#include <cstring>
+#include <optional>
 #include <ranges>
+#include <typeindex>
 
 namespace lg::llvm_ir_gen
 {
-    LLVMIRGenerator::LLVMIRGenerator(ir::IRModule* module, llvm::LLVMContext* context, llvm::Module* llvmModule) :
-        module(module), context(context), llvmModule(llvmModule)
+    namespace
+    {
+        constexpr uint32_t LIKELY_BRANCH_WEIGHT = 2000;
+        constexpr uint32_t UNLIKELY_BRANCH_WEIGHT = 1;
+
+        const std::unordered_map<std::string, llvm::CallingConv::ID> CALLING_CONVENTIONS = {
+            {"fastcc", llvm::CallingConv::Fast},
+            {"coldcc", llvm::CallingConv::Cold},
+            {"tailcc", llvm::CallingConv::Tail},
+            {"preserve_most", llvm::CallingConv::PreserveMost},
+            {"preserve_all", llvm::CallingConv::PreserveAll},
+        };
+
+        enum class InstructionKind : uint8_t
+        {
+            ASSEMBLY,
+            BINARY_OPERATES,
+            UNARY_OPERATES,
+            GET_ELEMENT_POINTER,
+            COMPARE,
+            CONDITIONAL_JUMP,
+            GOTO,
+            INVOKE,
+            RETURN,
+            LOAD,
+            STORE,
+            NOP,
+            SET_REGISTER,
+            STACK_ALLOCATE,
+            TYPE_CAST,
+            PHI,
+            SWITCH
+        };
+
+        const std::unordered_map<std::type_index, InstructionKind> INSTRUCTION_KINDS = {
+            {typeid(ir::instruction::IRAssembly), InstructionKind::ASSEMBLY},
+            {typeid(ir::instruction::IRBinaryOperates), InstructionKind::BINARY_OPERATES},
+            {typeid(ir::instruction::IRUnaryOperates), InstructionKind::UNARY_OPERATES},
+            {typeid(ir::instruction::IRGetElementPointer), InstructionKind::GET_ELEMENT_POINTER},
+            {typeid(ir::instruction::IRCompare), InstructionKind::COMPARE},
+            {typeid(ir::instruction::IRConditionalJump), InstructionKind::CONDITIONAL_JUMP},
+            {typeid(ir::instruction::IRGoto), InstructionKind::GOTO},
+            {typeid(ir::instruction::IRInvoke), InstructionKind::INVOKE},
+            {typeid(ir::instruction::IRReturn), InstructionKind::RETURN},
+            {typeid(ir::instruction::IRLoad), InstructionKind::LOAD},
+            {typeid(ir::instruction::IRStore), InstructionKind::STORE},
+            {typeid(ir::instruction::IRNop), InstructionKind::NOP},
+            {typeid(ir::instruction::IRSetRegister), InstructionKind::SET_REGISTER},
+            {typeid(ir::instruction::IRStackAllocate), InstructionKind::STACK_ALLOCATE},
+            {typeid(ir::instruction::IRTypeCast), InstructionKind::TYPE_CAST},
+            {typeid(ir::instruction::IRPhi), InstructionKind::PHI},
+            {typeid(ir::instruction::IRSwitch), InstructionKind::SWITCH},
+        };
+
+        // The numeric second argument of a weight or loop hint.
+        uint32_t parseHintNumber(const Attribute& attribute, ir::function::IRFunction* irFunction)
+        {
+            uint32_t value;
+            if (llvm::StringRef(attribute.arguments[1]).getAsInteger(10, value))
+                throw std::runtime_error("invalid number " + attribute.arguments[1] + " in " + attribute.name +
+                    " of function " + irFunction->name);
+            return value;
+        }
+
+        template <typename T>
+        void appendRaw(std::vector<char>& data, T value)
+        {
+            const auto offset = data.size();
+            data.resize(offset + sizeof(T));
+            std::memcpy(data.data() + offset, &value, sizeof(T));
+        }
+
+        // Packs arrays of integer or floating-point constants straight into a ConstantDataArray, skipping
+        // the per-element visit and Constant objects. Returns nullptr when an element doesn't fit.
+        template <typename Elements>
+        llvm::Constant* createDataArray(llvm::ArrayType* arrayType, const Elements& elements)
+        {
+            auto* elementType = arrayType->getElementType();
+            if (elements.empty() || elements.size() != arrayType->getNumElements()) return nullptr;
+            if (!llvm::ConstantDataSequential::isElementTypeCompatible(elementType)) return nullptr;
+            std::vector<char> data;
+            data.reserve(elements.size() * (elementType->getPrimitiveSizeInBits() / 8));
+            for (const auto& element : elements)
+            {
+                if (const auto* integer = dynamic_cast<ir::value::constant::IRIntegerConstant*>(element))
+                {
+                    if (!elementType->isIntegerTy()) return nullptr;
+                    const auto value = static_cast<uint64_t>(integer->value);
+                    switch (elementType->getIntegerBitWidth())
+                    {
+                    case 8:
+                        appendRaw(data, static_cast<uint8_t>(value));
+                        break;
+                    case 16:
+                        appendRaw(data, static_cast<uint16_t>(value));
+                        break;
+                    case 32:
+                        appendRaw(data, static_cast<uint32_t>(value));
+                        break;
+                    case 64:
+                        appendRaw(data, value);
+                        break;
+                    default:
+                        return nullptr;
+                    }
+                }
+                else if (const auto* floatConstant = dynamic_cast<ir::value::constant::IRFloatConstant*>(element))
+                {
+                    if (!elementType->isFloatTy()) return nullptr;
+                    appendRaw(data, static_cast<float>(floatConstant->value));
+                }
+                else if (const auto* doubleConstant = dynamic_cast<ir::value::constant::IRDoubleConstant*>(element))
+                {
+                    if (!elementType->isDoubleTy()) return nullptr;
+                    appendRaw(data, static_cast<double>(doubleConstant->value));
+                }
+                else
+                {
+                    return nullptr;
+                }
+            }
+            return llvm::ConstantDataArray::getRaw(llvm::StringRef(data.data(), data.size()), elements.size(),
+                                                   elementType);
+        }
+
+        // Builds the initializer of an `embed(path)` global from the file's bytes, read through a
+        // memory-mapped buffer. Multi-byte elements are taken in host byte order.
+        llvm::Constant* createEmbeddedInitializer(llvm::GlobalVariable* global, const Attribute& attribute)
+        {
+            if (attribute.arguments.size() != 1)
+                throw std::runtime_error("embed expects a file path on global " + global->getName().str());
+            auto* arrayType = llvm::dyn_cast<llvm::ArrayType>(global->getValueType());
+            if (arrayType == nullptr || !llvm::ConstantDataSequential::isElementTypeCompatible(
+                arrayType->getElementType()))
+                throw std::runtime_error("embed requires an integer or floating-point array on global " +
+                    global->getName().str());
+            const auto& path = attribute.arguments[0];
+            auto buffer = llvm::MemoryBuffer::getFile(path, false, false);
+            if (!buffer) throw std::runtime_error("Failed to read " + path + ": " + buffer.getError().message());
+            const auto elementSize = arrayType->getElementType()->getPrimitiveSizeInBits() / 8;
+            if ((*buffer)->getBufferSize() != arrayType->getNumElements() * elementSize)
+                throw std::runtime_error(
+                    "Size of " + path + " does not match the type of global " + global->getName().str());
+            return llvm::ConstantDataArray::getRaw((*buffer)->getBuffer(), arrayType->getNumElements(),
+                                                   arrayType->getElementType());
+        }
+    }
+
+    LLVMIRGenerator::LLVMIRGenerator(ir::IRModule* module, llvm::LLVMContext* context, llvm::Module* llvmModule,
+                                     GeneratorOptions options) :
+        module(module), options(std::move(options)), context(context), llvmModule(llvmModule)
     {
         builder = new llvm::IRBuilder(*context);
     }
@@ -22,9 +182,120 @@ namespace lg::llvm_ir_gen
     std::string LLVMIRGenerator::generate()
     {
         visit(module, nullptr);
+        emitMultiversionedFunctions();
+        if (!counters.empty()) emitCounterRuntime();
         return "";
     }
 
+    // Scalar types are classified and lowered straight from their class; only aggregates and function types go
+    // through visit. Nothing is cached by address, since getType() may hand out a new type object per call.
+    TypeInfo LLVMIRGenerator::classifyType(IRType* type)
+    {
+        if (const auto* integerType = dynamic_cast<ir::type::IRIntegerType*>(type))
+        {
+            return {integerType->_unsigned ? TypeKind::UNSIGNED_INTEGER : TypeKind::SIGNED_INTEGER,
+                    llvm::IntegerType::get(*context, static_cast<uint32_t>(integerType->size))};
+        }
+        if (const auto* pointerType = dynamic_cast<ir::type::IRPointerType*>(type))
+            return {TypeKind::POINTER, llvm::PointerType::get(*context, 0), pointerType->base};
+        if (dynamic_cast<ir::type::IRFloatType*>(type) != nullptr)
+            return {TypeKind::FLOAT, llvm::Type::getFloatTy(*context)};
+        if (dynamic_cast<ir::type::IRDoubleType*>(type) != nullptr)
+            return {TypeKind::DOUBLE, llvm::Type::getDoubleTy(*context)};
+        if (dynamic_cast<ir::type::IRVoidType*>(type) != nullptr)
+            return {TypeKind::VOID, llvm::Type::getVoidTy(*context)};
+        visit(type, nullptr);
+        TypeInfo info{TypeKind::AGGREGATE, std::any_cast<llvm::Type*>(stack.top())};
+        stack.pop();
+        if (dynamic_cast<ir::type::IRFunctionReferenceType*>(type) != nullptr) info.kind = TypeKind::FUNCTION;
+        return info;
+    }
+
+    llvm::Type* LLVMIRGenerator::lowerType(IRType* type)
+    {
+        return classifyType(type).llvmType;
+    }
+
+    // Registers and local variables make up most operands; they are looked up directly instead of going
+    // through visit and the value stack.
+    llvm::Value* LLVMIRGenerator::lowerOperand(IROperand* value)
+    {
+        const std::type_index kind = typeid(*value);
+        if (kind == typeid(ir::value::IRRegister))
+            return register2Value[static_cast<ir::value::IRRegister*>(value)];
+        if (kind == typeid(ir::value::IRLocalVariableReference))
+            return irLocalVariable2Value[static_cast<ir::value::IRLocalVariableReference*>(value)->variable];
+        visit(value, nullptr);
+        auto* result = std::any_cast<llvm::Value*>(stack.top());
+        stack.pop();
+        return result;
+    }
+
+    // Calls the visitor for the instruction's concrete class directly rather than through accept.
+    void LLVMIRGenerator::lowerInstruction(IRInstruction* instruction, const std::any& additional)
+    {
+        const auto it = INSTRUCTION_KINDS.find(typeid(*instruction));
+        if (it == INSTRUCTION_KINDS.end())
+        {
+            visit(instruction, additional);
+            return;
+        }
+        using namespace ir::instruction;
+        switch (it->second)
+        {
+        case InstructionKind::ASSEMBLY:
+            visitAssembly(static_cast<IRAssembly*>(instruction), additional);
+            break;
+        case InstructionKind::BINARY_OPERATES:
+            visitBinaryOperates(static_cast<IRBinaryOperates*>(instruction), additional);
+            break;
+        case InstructionKind::UNARY_OPERATES:
+            visitUnaryOperates(static_cast<IRUnaryOperates*>(instruction), additional);
+            break;
+        case InstructionKind::GET_ELEMENT_POINTER:
+            visitGetElementPointer(static_cast<IRGetElementPointer*>(instruction), additional);
+            break;
+        case InstructionKind::COMPARE:
+            visitCompare(static_cast<IRCompare*>(instruction), additional);
+            break;
+        case InstructionKind::CONDITIONAL_JUMP:
+            visitConditionalJump(static_cast<IRConditionalJump*>(instruction), additional);
+            break;
+        case InstructionKind::GOTO:
+            visitGoto(static_cast<IRGoto*>(instruction), additional);
+            break;
+        case InstructionKind::INVOKE:
+            visitInvoke(static_cast<IRInvoke*>(instruction), additional);
+            break;
+        case InstructionKind::RETURN:
+            visitReturn(static_cast<IRReturn*>(instruction), additional);
+            break;
+        case InstructionKind::LOAD:
+            visitLoad(static_cast<IRLoad*>(instruction), additional);
+            break;
+        case InstructionKind::STORE:
+            visitStore(static_cast<IRStore*>(instruction), additional);
+            break;
+        case InstructionKind::NOP:
+            break;
+        case InstructionKind::SET_REGISTER:
+            visitSetRegister(static_cast<IRSetRegister*>(instruction), additional);
+            break;
+        case InstructionKind::STACK_ALLOCATE:
+            visitStackAllocate(static_cast<IRStackAllocate*>(instruction), additional);
+            break;
+        case InstructionKind::TYPE_CAST:
+            visitTypeCast(static_cast<IRTypeCast*>(instruction), additional);
+            break;
+        case InstructionKind::PHI:
+            visitPhi(static_cast<IRPhi*>(instruction), additional);
+            break;
+        case InstructionKind::SWITCH:
+            visitSwitch(static_cast<IRSwitch*>(instruction), additional);
+            break;
+        }
+    }
+
     std::any LLVMIRGenerator::visitModule(ir::IRModule* module, std::any additional)
     {
         for (const auto& structure : module->structures | std::views::values)
@@ -45,6 +316,7 @@ namespace lg::llvm_ir_gen
                 global->name
             );
         }
+        const auto target = getModuleTarget(llvmModule);
         for (const auto& func : module->functions | std::views::values)
         {
             visit(func->returnType, additional);
@@ -65,6 +337,12 @@ namespace lg::llvm_ir_gen
                 llvmModule
             );
             for (auto& arg : llvmFunction->args())arg.setName(func->args[arg.getArgNo()]->name);
+            if (!func->isExtern)
+            {
+                if (!target.cpu.empty()) llvmFunction->addFnAttr("target-cpu", target.cpu);
+                if (!target.features.empty()) llvmFunction->addFnAttr("target-features", target.features);
+            }
+            applyFunctionAttributes(func, llvmFunction);
         }
         for (const auto& structure : module->structures | std::views::values)
         {
@@ -77,27 +355,325 @@ namespace lg::llvm_ir_gen
         for (const auto& func : module->functions | std::views::values)
         {
             visit(func, additional);
+            if (options.onFunctionGenerated) options.onFunctionGenerated(func);
         }
         return nullptr;
     }
 
+    void LLVMIRGenerator::applyFunctionAttributes(ir::function::IRFunction* irFunction, llvm::Function* llvmFunction)
+    {
+        for (const auto& text : irFunction->attributes)
+        {
+            const auto attribute = parseAttribute(text);
+            if (attribute.name == "cold") llvmFunction->addFnAttr(llvm::Attribute::Cold);
+            else if (attribute.name == "hot") llvmFunction->addFnAttr(llvm::Attribute::Hot);
+            else if (const auto it = CALLING_CONVENTIONS.find(attribute.name); it != CALLING_CONVENTIONS.end())
+                llvmFunction->setCallingConv(it->second);
+        }
+    }
+
+    // tail(callee), musttail(callee) and notail(callee) on the caller set the tail call kind of its calls to callee.
+    void LLVMIRGenerator::collectTailCallHints(ir::function::IRFunction* irFunction)
+    {
+        for (const auto& text : irFunction->attributes)
+        {
+            const auto attribute = parseAttribute(text);
+            llvm::CallInst::TailCallKind kind;
+            if (attribute.name == "tail") kind = llvm::CallInst::TCK_Tail;
+            else if (attribute.name == "musttail") kind = llvm::CallInst::TCK_MustTail;
+            else if (attribute.name == "notail") kind = llvm::CallInst::TCK_NoTail;
+            else continue;
+            if (attribute.arguments.empty())
+                throw std::runtime_error(attribute.name + " requires a callee in function " + irFunction->name);
+            for (const auto& callee : attribute.arguments) tailCallKinds[callee] = kind;
+        }
+    }
+
+    // tail and musttail only reach calls in tail position, whose result is returned by the very next
+    // instruction; other calls to the same callee keep the default. A musttail call must also keep the
+    // caller's convention and, unless both use tailcc, its signature.
+    void LLVMIRGenerator::applyTailCallHints(ir::function::IRFunction* irFunction)
+    {
+        if (tailCallKinds.empty()) return;
+        for (auto& block : *currentFunction)
+        {
+            for (auto& instruction : block)
+            {
+                auto* call = llvm::dyn_cast<llvm::CallInst>(&instruction);
+                if (call == nullptr || call->getCalledFunction() == nullptr) continue;
+                const auto callee = call->getCalledFunction()->getName().str();
+                const auto it = tailCallKinds.find(callee);
+                if (it == tailCallKinds.end()) continue;
+                if (it->second != llvm::CallInst::TCK_NoTail)
+                {
+                    auto* ret = llvm::dyn_cast_or_null<llvm::ReturnInst>(call->getNextNode());
+                    if (ret == nullptr) continue;
+                    if (ret->getReturnValue() != (call->getType()->isVoidTy() ? nullptr : call)) continue;
+                }
+                call->setTailCallKind(it->second);
+                if (!call->isMustTailCall()) continue;
+                if (call->getCallingConv() != currentFunction->getCallingConv())
+                    throw std::runtime_error("musttail call to " + callee + " in function " + irFunction->name +
+                        " must use the caller's calling convention");
+                const auto convention = call->getCallingConv();
+                if (convention != llvm::CallingConv::Tail && convention != llvm::CallingConv::SwiftTail &&
+                    call->getFunctionType() != currentFunction->getFunctionType())
+                    throw std::runtime_error("musttail call to " + callee + " in function " + irFunction->name +
+                        " must match the caller's signature unless both use tailcc");
+            }
+        }
+    }
+
+    // lg function-reference types carry no calling convention, so every indirect call uses the C one. A
+    // function with another convention that is used as a value is therefore replaced by <name>.ccc, a C
+    // wrapper forwarding to it, and direct calls keep reaching the function itself.
+    llvm::Function* LLVMIRGenerator::getCEntryPoint(llvm::Function* function)
+    {
+        if (function->getCallingConv() == llvm::CallingConv::C) return function;
+        const auto name = function->getName().str() + ".ccc";
+        if (auto* entryPoint = llvmModule->getFunction(name)) return entryPoint;
+        if (function->isVarArg())
+            throw std::runtime_error("variadic function " + function->getName().str() +
+                " has a non-C calling convention and cannot be used as a function reference");
+        auto* entryPoint = llvm::Function::Create(function->getFunctionType(), llvm::GlobalValue::InternalLinkage,
+                                                  name, llvmModule);
+        entryPoint->copyAttributesFrom(function);
+        entryPoint->setCallingConv(llvm::CallingConv::C);
+        llvm::IRBuilder<> entryBuilder(llvm::BasicBlock::Create(*context, "entry", entryPoint));
+        std::vector<llvm::Value*> args;
+        for (auto& arg : entryPoint->args()) args.push_back(&arg);
+        auto* call = entryBuilder.CreateCall(function, args);
+        call->setCallingConv(function->getCallingConv());
+        call->setTailCallKind(llvm::CallInst::TCK_Tail);
+        if (call->getType()->isVoidTy()) entryBuilder.CreateRetVoid();
+        else entryBuilder.CreateRet(call);
+        return entryPoint;
+    }
+
+    llvm::BasicBlock* LLVMIRGenerator::findHintBlock(ir::function::IRFunction* irFunction,
+                                                     const Attribute& attribute)
+    {
+        if (attribute.arguments.empty())
+            throw std::runtime_error(attribute.name + " requires a block name in function " + irFunction->name);
+        for (const auto& [block, llvmBlock] : irBlock2LLVMBlock)
+            if (block->name == attribute.arguments[0]) return llvmBlock;
+        throw std::runtime_error(
+            "unknown block " + attribute.arguments[0] + " in " + attribute.name + " of function " + irFunction->name);
+    }
+
+    void LLVMIRGenerator::collectBranchHints(ir::function::IRFunction* irFunction)
+    {
+        for (const auto& text : irFunction->attributes)
+        {
+            const auto attribute = parseAttribute(text);
+            if (attribute.name == "likely")
+                blockBranchWeights[findHintBlock(irFunction, attribute)] = LIKELY_BRANCH_WEIGHT;
+            else if (attribute.name == "unlikely")
+                blockBranchWeights[findHintBlock(irFunction, attribute)] = UNLIKELY_BRANCH_WEIGHT;
+            else if (attribute.name == "weight")
+            {
+                auto* block = findHintBlock(irFunction, attribute);
+                if (attribute.arguments.size() != 2)
+                    throw std::runtime_error("weight expects a block and a weight in function " + irFunction->name);
+                blockBranchWeights[block] = parseHintNumber(attribute, irFunction);
+            }
+        }
+    }
+
+    // Loop hints name the loop header: loop_unroll(header, count|full|disable),
+    // loop_vectorize(header, width|disable), loop_interleave(header, count), loop_distribute(header)
+    // and loop_mustprogress(header). They become one llvm.loop node shared by every back-edge into the header.
+    void LLVMIRGenerator::collectLoopHints(ir::function::IRFunction* irFunction)
+    {
+        std::unordered_map<llvm::BasicBlock*, std::vector<llvm::Metadata*>> hints;
+        auto flag = [this](const std::string& name) -> llvm::Metadata*
+        {
+            return llvm::MDNode::get(*context, llvm::MDString::get(*context, name));
+        };
+        auto value = [this](const std::string& name, llvm::Constant* constant) -> llvm::Metadata*
+        {
+            return llvm::MDNode::get(*context, {
+                                         llvm::MDString::get(*context, name),
+                                         llvm::ConstantAsMetadata::get(constant)
+                                     });
+        };
+        auto count = [irFunction](const Attribute& attribute) -> uint32_t
+        {
+            if (attribute.arguments.size() != 2)
+                throw std::runtime_error(attribute.name + " expects a block and a count in function " +
+                    irFunction->name);
+            return parseHintNumber(attribute, irFunction);
+        };
+        for (const auto& text : irFunction->attributes)
+        {
+            const auto attribute = parseAttribute(text);
+            if (!attribute.name.starts_with("loop_")) continue;
+            auto& header = hints[findHintBlock(irFunction, attribute)];
+            const auto argument = attribute.arguments.size() > 1 ? attribute.arguments[1] : "";
+            if (attribute.name == "loop_unroll")
+            {
+                if (argument == "full") header.push_back(flag("llvm.loop.unroll.full"));
+                else if (argument == "disable") header.push_back(flag("llvm.loop.unroll.disable"));
+                else header.push_back(value("llvm.loop.unroll.count", builder->getInt32(count(attribute))));
+            }
+            else if (attribute.name == "loop_vectorize")
+            {
+                if (argument == "disable")
+                {
+                    header.push_back(value("llvm.loop.vectorize.enable", builder->getFalse()));
+                    continue;
+                }
+                header.push_back(value("llvm.loop.vectorize.enable", builder->getTrue()));
+                if (!argument.empty())
+                    header.push_back(value("llvm.loop.vectorize.width", builder->getInt32(count(attribute))));
+            }
+            else if (attribute.name == "loop_interleave")
+                header.push_back(value("llvm.loop.interleave.count", builder->getInt32(count(attribute))));
+            else if (attribute.name == "loop_distribute")
+                header.push_back(value("llvm.loop.distribute.enable", builder->getTrue()));
+            else if (attribute.name == "loop_mustprogress")
+                header.push_back(flag("llvm.loop.mustprogress"));
+            else
+                throw std::runtime_error("unknown loop hint " + attribute.name + " in function " + irFunction->name);
+        }
+        for (auto& [header, operands] : hints)
+        {
+            operands.insert(operands.begin(), nullptr);
+            auto* loopID = llvm::MDNode::getDistinct(*context, operands);
+            loopID->replaceOperandWith(0, loopID);
+            loopMetadata[header] = loopID;
+        }
+    }
+
+    // Blocks are laid out in lg order, so a jump to a hinted header at or before the current block closes the loop.
+    void LLVMIRGenerator::attachLoopMetadata(llvm::Instruction* branch)
+    {
+        if (loopMetadata.empty()) return;
+        auto* current = branch->getParent();
+        for (auto* successor : llvm::successors(branch))
+        {
+            const auto it = loopMetadata.find(successor);
+            if (it == loopMetadata.end()) continue;
+            for (auto& block : *currentFunction)
+            {
+                if (&block == successor)
+                {
+                    branch->setMetadata(llvm::LLVMContext::MD_loop, it->second);
+                    return;
+                }
+                if (&block == current) break;
+            }
+        }
+    }
+
+    // Edges without a hint share whatever the hinted edges leave: they are likely when every
+    // hinted edge is unlikely and unlikely otherwise.
+    llvm::MDNode* LLVMIRGenerator::createBranchWeights(const std::vector<llvm::BasicBlock*>& successors)
+    {
+        bool hinted = false;
+        bool anyLikely = false;
+        for (auto* successor : successors)
+        {
+            if (const auto it = blockBranchWeights.find(successor); it != blockBranchWeights.end())
+            {
+                hinted = true;
+                anyLikely |= it->second > UNLIKELY_BRANCH_WEIGHT;
+            }
+        }
+        if (!hinted) return nullptr;
+        std::vector<uint32_t> weights;
+        for (auto* successor : successors)
+        {
+            const auto it = blockBranchWeights.find(successor);
+            if (it != blockBranchWeights.end()) weights.push_back(it->second);
+            else weights.push_back(anyLikely ? UNLIKELY_BRANCH_WEIGHT : LIKELY_BRANCH_WEIGHT);
+        }
+        return llvm::MDBuilder(*context).createBranchWeights(weights);
+    }
+
+    const std::vector<StructureLayout>& LLVMIRGenerator::getStructureLayouts() const
+    {
+        return structureLayouts;
+    }
+
+    // Structures embedded by value must have a body before this one can be laid out.
+    void LLVMIRGenerator::ensureStructureBody(llvm::Type* type)
+    {
+        while (type->isArrayTy() || type->isVectorTy())
+        {
+            if (type->isArrayTy()) type = type->getArrayElementType();
+            else type = llvm::cast<llvm::VectorType>(type)->getElementType();
+        }
+        auto* structType = llvm::dyn_cast<llvm::StructType>(type);
+        if (structType == nullptr || !structType->isOpaque()) return;
+        for (const auto& [structure, llvmStructType] : irStructure2LLVMStructureType)
+            if (llvmStructType == structType) visit(structure, nullptr);
+    }
+
     std::any LLVMIRGenerator::visitStructure(ir::structure::IRStructure* irStructure, std::any additional)
     {
+        auto* structType = irStructure2LLVMStructureType[irStructure];
+        if (!structType->isOpaque()) return nullptr;
         std::vector<llvm::Type*> fields;
+        std::vector<std::string> names;
         for (const auto& field : irStructure->fields)
         {
             visit(field->type, additional);
             fields.push_back(std::any_cast<llvm::Type*>(stack.top()));
             stack.pop();
+            names.push_back(field->name);
         }
-        irStructure2LLVMStructureType[irStructure]->setBody(
-            fields, std::ranges::find(irStructure->attributes, "packed") != irStructure->attributes.end());
+        for (auto* field : fields) ensureStructureBody(field);
+
+        std::vector<bool> hot(fields.size(), false);
+        for (const auto& attribute : findAttributes(irStructure->attributes, "hot_fields"))
+        {
+            for (const auto& name : attribute.arguments)
+            {
+                const auto it = std::ranges::find(names, name);
+                if (it == names.end())
+                    throw std::runtime_error("unknown field " + name + " in hot_fields of " + irStructure->name);
+                hot[it - names.begin()] = true;
+            }
+        }
+
+        const bool packed = std::ranges::find(irStructure->attributes, "packed") != irStructure->attributes.end();
+        const bool reorder = options.reorderStructures && !packed &&
+            hasAttribute(irStructure->attributes, "reorderable");
+        if (reorder)
+        {
+            const auto order = suggestFieldOrder(llvmModule->getDataLayout(), fields, hot);
+            std::vector<unsigned> positions(order.size());
+            std::vector<llvm::Type*> orderedFields;
+            std::vector<std::string> orderedNames;
+            std::vector<bool> orderedHot;
+            for (unsigned i = 0; i < order.size(); ++i)
+            {
+                positions[order[i]] = i;
+                orderedFields.push_back(fields[order[i]]);
+                orderedNames.push_back(names[order[i]]);
+                orderedHot.push_back(hot[order[i]]);
+            }
+            structureFieldPositions[structType] = std::move(positions);
+            fields = std::move(orderedFields);
+            names = std::move(orderedNames);
+            hot = std::move(orderedHot);
+        }
+        structType->setBody(fields, packed);
+        structureLayouts.push_back(analyzeStructure(llvmModule->getDataLayout(), structType, names, hot));
+        structureLayouts.back().reordered = reorder;
         return nullptr;
     }
 
 
     std::any LLVMIRGenerator::visitGlobalVariable(ir::base::IRGlobalVariable* irGlobalVariable, std::any additional)
     {
+        if (const auto embeds = findAttributes(irGlobalVariable->attributes, "embed"); !embeds.empty())
+        {
+            auto* global = irGlobalVariable2LLVMGlobalVariable[irGlobalVariable];
+            global->setInitializer(createEmbeddedInitializer(global, embeds.front()));
+            return nullptr;
+        }
         visit(irGlobalVariable->initializer, additional);
         auto* value = std::any_cast<llvm::Value*>(stack.top());
         auto* initializer = llvm::dyn_cast<llvm::Constant>(value);
@@ -111,6 +687,9 @@ namespace lg::llvm_ir_gen
     {
         if (!irFunction->isExtern)
         {
+            if (options.loadFunctionBody) options.loadFunctionBody(irFunction);
+            if (irFunction->cfg->basicBlocks.empty())
+                throw std::runtime_error("function " + irFunction->name + " has no body; load it before generating");
             currentFunction = llvmModule->getFunction(irFunction->name);
             llvm::BasicBlock* initBlock = llvm::BasicBlock::Create(*context, "init_frame", currentFunction);
             for (const auto& block : irFunction->cfg->basicBlocks | std::views::values)
@@ -118,34 +697,52 @@ namespace lg::llvm_ir_gen
                 llvm::BasicBlock* llvmBlock = llvm::BasicBlock::Create(*context, block->name, currentFunction);
                 irBlock2LLVMBlock[block] = llvmBlock;
             }
+            collectBranchHints(irFunction);
+            collectLoopHints(irFunction);
+            collectTailCallHints(irFunction);
             builder->SetInsertPoint(initBlock);
             for (size_t i = 0; i < irFunction->args.size(); ++i)
             {
                 auto* arg = irFunction->args[i];
-                visit(arg->type, additional);
-                auto* ty = std::any_cast<llvm::Type*>(stack.top());
-                stack.pop();
-                auto* ptr = builder->CreateAlloca(ty);
+                auto* ptr = builder->CreateAlloca(lowerType(arg->type));
                 builder->CreateStore(currentFunction->getArg(i), ptr);
                 irLocalVariable2Value[arg] = ptr;
             }
             for (const auto& local : irFunction->locals)
             {
-                visit(local->type, additional);
-                auto* ty = std::any_cast<llvm::Type*>(stack.top());
-                stack.pop();
-                auto* ptr = builder->CreateAlloca(ty);
+                auto* ptr = builder->CreateAlloca(lowerType(local->type));
                 irLocalVariable2Value[local] = ptr;
             }
-            builder->CreateBr(initBlock->getNextNode());
+            auto* firstBlock = initBlock->getNextNode();
+            if (options.counters != CounterMode::NONE)
+            {
+                emitCounterIncrement(irFunction->name);
+                emitCounterDumpCheck(firstBlock);
+            }
+            builder->CreateBr(firstBlock);
             for (const auto& block : irFunction->cfg->basicBlocks | std::views::values)
             {
-                builder->SetInsertPoint(irBlock2LLVMBlock[block]);
-                for (const auto& instruction : block->instructions)visit(instruction, additional);
+                auto* llvmBlock = irBlock2LLVMBlock[block];
+                builder->SetInsertPoint(llvmBlock);
+                for (const auto& instruction : block->instructions) lowerInstruction(instruction, additional);
+                // Phis have to lead the block, so the counter goes in once they exist.
+                if (options.counters == CounterMode::BASIC_BLOCK)
+                {
+                    builder->SetInsertPoint(llvmBlock, llvmBlock->getFirstInsertionPt());
+                    emitCounterIncrement(irFunction->name + ":" + block->name);
+                }
             }
+            // The register may still be read by an instruction after the store, so this waits for the whole body.
+            for (auto* load : copiedAggregateLoads)
+                if (load->use_empty()) load->eraseFromParent();
+            copiedAggregateLoads.clear();
+            applyTailCallHints(irFunction);
             irBlock2LLVMBlock.clear();
             irLocalVariable2Value.clear();
             register2Value.clear();
+            blockBranchWeights.clear();
+            loopMetadata.clear();
+            tailCallKinds.clear();
         }
         return nullptr;
     }
@@ -156,9 +753,7 @@ namespace lg::llvm_ir_gen
         std::vector<llvm::Type*> argTypes(irAssembly->operands.size());
         for (size_t i = 0; i < irAssembly->operands.size(); ++i)
         {
-            visit(irAssembly->operands[i], additional);
-            operands[i] = std::any_cast<llvm::Value*>(stack.top());
-            stack.pop();
+            operands[i] = lowerOperand(irAssembly->operands[i]);
             argTypes[i] = operands[i]->getType();
         }
         auto* functionType = llvm::FunctionType::get(llvm::Type::getVoidTy(*context), argTypes, false);
@@ -171,18 +766,15 @@ namespace lg::llvm_ir_gen
     std::any LLVMIRGenerator::visitBinaryOperates(ir::instruction::IRBinaryOperates* irBinaryOperates,
                                                   std::any additional)
     {
-        visit(irBinaryOperates->operand1, additional);
-        auto* operand1 = std::any_cast<llvm::Value*>(stack.top());
-        stack.pop();
-        visit(irBinaryOperates->operand2, additional);
-        auto* operand2 = std::any_cast<llvm::Value*>(stack.top());
-        stack.pop();
+        auto* operand1 = lowerOperand(irBinaryOperates->operand1);
+        auto* operand2 = lowerOperand(irBinaryOperates->operand2);
+        const auto& type = classifyType(irBinaryOperates->operand1->getType());
         llvm::Value* result;
         switch (irBinaryOperates->op)
         {
         case ir::instruction::IRBinaryOperates::Operator::ADD:
             {
-                if (dynamic_cast<ir::type::IRIntegerType*>(irBinaryOperates->operand1->getType()))
+                if (type.isInteger())
                     result = builder->CreateAdd(operand1, operand2);
                 else
                     result = builder->CreateFAdd(operand1, operand2);
@@ -190,7 +782,7 @@ namespace lg::llvm_ir_gen
             }
         case ir::instruction::IRBinaryOperates::Operator::SUB:
             {
-                if (dynamic_cast<ir::type::IRIntegerType*>(irBinaryOperates->operand1->getType()))
+                if (type.isInteger())
                     result = builder->CreateSub(operand1, operand2);
                 else
                     result = builder->CreateFSub(operand1, operand2);
@@ -198,7 +790,7 @@ namespace lg::llvm_ir_gen
             }
         case ir::instruction::IRBinaryOperates::Operator::MUL:
             {
-                if (dynamic_cast<ir::type::IRIntegerType*>(irBinaryOperates->operand1->getType()))
+                if (type.isInteger())
                     result = builder->CreateMul(operand1, operand2);
                 else
                     result = builder->CreateFMul(operand1, operand2);
@@ -206,14 +798,12 @@ namespace lg::llvm_ir_gen
             }
         case ir::instruction::IRBinaryOperates::Operator::DIV:
             {
-                auto* type = irBinaryOperates->operand1->getType();
-                if (const auto* integerType = dynamic_cast<ir::type::IRIntegerType*>(type))
+                if (type.isInteger())
                 {
-                    if (integerType->_unsigned) result = builder->CreateUDiv(operand1, operand2);
+                    if (type.kind == TypeKind::UNSIGNED_INTEGER) result = builder->CreateUDiv(operand1, operand2);
                     else result = builder->CreateSDiv(operand1, operand2);
                 }
-                else if (dynamic_cast<ir::type::IRFloatType*>(type) != nullptr || dynamic_cast<ir::type::IRDoubleType*>(
-                    type) != nullptr)
+                else if (type.isFloatingPoint())
                 {
                     result = builder->CreateFDiv(operand1, operand2);
                 }
@@ -225,14 +815,12 @@ namespace lg::llvm_ir_gen
             }
         case ir::instruction::IRBinaryOperates::Operator::MOD:
             {
-                auto* type = irBinaryOperates->operand1->getType();
-                if (const auto* integerType = dynamic_cast<ir::type::IRIntegerType*>(type))
+                if (type.isInteger())
                 {
-                    if (integerType->_unsigned) result = builder->CreateURem(operand1, operand2);
+                    if (type.kind == TypeKind::UNSIGNED_INTEGER) result = builder->CreateURem(operand1, operand2);
                     else result = builder->CreateSRem(operand1, operand2);
                 }
-                else if (dynamic_cast<ir::type::IRFloatType*>(type) != nullptr || dynamic_cast<ir::type::IRDoubleType*>(
-                    type) != nullptr)
+                else if (type.isFloatingPoint())
                 {
                     result = builder->CreateFRem(operand1, operand2);
                 }
@@ -283,17 +871,13 @@ namespace lg::llvm_ir_gen
 
     std::any LLVMIRGenerator::visitUnaryOperates(ir::instruction::IRUnaryOperates* irUnaryOperates, std::any additional)
     {
-        visit(irUnaryOperates->operand, additional);
-        auto* operand = std::any_cast<llvm::Value*>(stack.top());
-        stack.pop();
+        auto* operand = lowerOperand(irUnaryOperates->operand);
         llvm::Value* result;
         switch (irUnaryOperates->op)
         {
         case ir::instruction::IRUnaryOperates::Operator::INC:
             {
-                visit(dynamic_cast<ir::type::IRPointerType*>(irUnaryOperates->operand->getType())->base, additional);
-                auto* ty = std::any_cast<llvm::Type*>(stack.top());
-                stack.pop();
+                auto* ty = lowerType(classifyType(irUnaryOperates->operand->getType()).base);
                 auto* tmp = builder->CreateLoad(ty, operand);
                 auto* val = builder->CreateAdd(tmp, llvm::ConstantInt::get(ty, 1));
                 result = builder->CreateStore(val, operand);
@@ -301,9 +885,7 @@ namespace lg::llvm_ir_gen
             }
         case ir::instruction::IRUnaryOperates::Operator::DEC:
             {
-                visit(dynamic_cast<ir::type::IRPointerType*>(irUnaryOperates->operand->getType())->base, additional);
-                auto* ty = std::any_cast<llvm::Type*>(stack.top());
-                stack.pop();
+                auto* ty = lowerType(classifyType(irUnaryOperates->operand->getType()).base);
                 auto* tmp = builder->CreateLoad(ty, operand);
                 auto* val = builder->CreateSub(tmp, llvm::ConstantInt::get(ty, 1));
                 result = builder->CreateStore(val, operand);
@@ -331,18 +913,35 @@ namespace lg::llvm_ir_gen
     std::any LLVMIRGenerator::visitGetElementPointer(ir::instruction::IRGetElementPointer* irGetElementPointer,
                                                      std::any additional)
     {
-        visit(dynamic_cast<ir::type::IRPointerType*>(irGetElementPointer->pointer->getType())->base, additional);
-        auto* type = std::any_cast<llvm::Type*>(stack.top());
-        stack.pop();
-        visit(irGetElementPointer->pointer, additional);
-        auto* ptr = std::any_cast<llvm::Value*>(stack.top());
-        stack.pop();
+        auto* type = lowerType(classifyType(irGetElementPointer->pointer->getType()).base);
+        auto* ptr = lowerOperand(irGetElementPointer->pointer);
         std::vector<llvm::Value*> indices;
+        auto* indexedType = type;
         for (const auto& index : irGetElementPointer->indices)
         {
-            visit(index, additional);
-            auto* indexValue = std::any_cast<llvm::Value*>(stack.top());
-            stack.pop();
+            auto* indexValue = lowerOperand(index);
+            if (!indices.empty())
+            {
+                if (auto* structType = llvm::dyn_cast<llvm::StructType>(indexedType))
+                {
+                    auto* fieldIndex = llvm::cast<llvm::ConstantInt>(indexValue);
+                    auto position = fieldIndex->getZExtValue();
+                    if (const auto it = structureFieldPositions.find(structType); it != structureFieldPositions.end())
+                    {
+                        position = it->second[position];
+                        indexValue = llvm::ConstantInt::get(fieldIndex->getType(), position);
+                    }
+                    indexedType = structType->getElementType(position);
+                }
+                else if (indexedType->isArrayTy())
+                {
+                    indexedType = indexedType->getArrayElementType();
+                }
+                else if (auto* vectorType = llvm::dyn_cast<llvm::VectorType>(indexedType))
+                {
+                    indexedType = vectorType->getElementType();
+                }
+            }
             indices.push_back(indexValue);
         }
         auto* result = builder->CreateGEP(type, ptr, indices);
@@ -352,24 +951,11 @@ namespace lg::llvm_ir_gen
 
     std::any LLVMIRGenerator::visitCompare(ir::instruction::IRCompare* irCompare, std::any additional)
     {
-        visit(irCompare->operand1, additional);
-        auto* operand1 = std::any_cast<llvm::Value*>(stack.top());
-        stack.pop();
-        visit(irCompare->operand2, additional);
-        auto* operand2 = std::any_cast<llvm::Value*>(stack.top());
-        stack.pop();
-        bool isInteger;
-        bool isUnsigned;
-        if (const auto* integerType = dynamic_cast<ir::type::IRIntegerType*>(irCompare->operand1->getType()))
-        {
-            isInteger = true;
-            isUnsigned = integerType->_unsigned;
-        }
-        else
-        {
-            isInteger = false;
-            isUnsigned = false;
-        }
+        auto* operand1 = lowerOperand(irCompare->operand1);
+        auto* operand2 = lowerOperand(irCompare->operand2);
+        const auto& type = classifyType(irCompare->operand1->getType());
+        const bool isInteger = type.isInteger();
+        const bool isUnsigned = type.kind == TypeKind::UNSIGNED_INTEGER;
         llvm::CmpInst::Predicate predicate;
         switch (irCompare->condition)
         {
@@ -438,28 +1024,14 @@ namespace lg::llvm_ir_gen
     std::any LLVMIRGenerator::visitConditionalJump(ir::instruction::IRConditionalJump* irConditionalJump,
                                                    std::any additional)
     {
-        visit(irConditionalJump->operand1, additional);
-        auto* operand1 = std::any_cast<llvm::Value*>(stack.top());
-        stack.pop();
+        auto* operand1 = lowerOperand(irConditionalJump->operand1);
         llvm::Value* cond;
         if (irConditionalJump->operand2 != nullptr)
         {
-            visit(irConditionalJump->operand2, additional);
-            auto* operand2 = std::any_cast<llvm::Value*>(stack.top());
-            stack.pop();
-            bool isInteger;
-            bool isUnsigned;
-            if (const auto* integerType = dynamic_cast<ir::type::IRIntegerType*>(irConditionalJump->operand1->
-                getType()))
-            {
-                isInteger = true;
-                isUnsigned = integerType->_unsigned;
-            }
-            else
-            {
-                isInteger = false;
-                isUnsigned = false;
-            }
+            auto* operand2 = lowerOperand(irConditionalJump->operand2);
+            const auto& type = classifyType(irConditionalJump->operand1->getType());
+            const bool isInteger = type.isInteger();
+            const bool isUnsigned = type.kind == TypeKind::UNSIGNED_INTEGER;
             llvm::CmpInst::Predicate predicate;
             switch (irConditionalJump->condition)
             {
@@ -539,35 +1111,42 @@ namespace lg::llvm_ir_gen
                     "unsupported condition: " + ir::base::conditionToString(irConditionalJump->condition));
             }
         }
-        builder->CreateCondBr(cond, irBlock2LLVMBlock[irConditionalJump->target],
-                              builder->GetInsertBlock()->getNextNode());
+        auto* trueBlock = irBlock2LLVMBlock[irConditionalJump->target];
+        auto* falseBlock = builder->GetInsertBlock()->getNextNode();
+        attachLoopMetadata(
+            builder->CreateCondBr(cond, trueBlock, falseBlock, createBranchWeights({trueBlock, falseBlock})));
         return nullptr;
     }
 
 
     std::any LLVMIRGenerator::visitGoto(ir::instruction::IRGoto* irGoto, std::any additional)
     {
-        builder->CreateBr(irBlock2LLVMBlock[irGoto->target]);
+        attachLoopMetadata(builder->CreateBr(irBlock2LLVMBlock[irGoto->target]));
         return nullptr;
     }
 
     std::any LLVMIRGenerator::visitInvoke(ir::instruction::IRInvoke* irInvoke, std::any additional)
     {
-        visit(irInvoke->func->getType(), additional);
-        auto* ty = std::any_cast<llvm::Type*>(stack.top());
-        stack.pop();
-        auto* funcType = llvm::cast<llvm::FunctionType>(ty);
-        visit(irInvoke->func, additional);
-        auto* func = std::any_cast<llvm::Value*>(stack.top());
-        stack.pop();
+        auto* funcType = llvm::cast<llvm::FunctionType>(lowerType(irInvoke->func->getType()));
+        // A direct call reaches the function itself in its own convention; lowering the reference as a value
+        // would go through its C entry point.
+        const auto* functionReference = dynamic_cast<ir::value::constant::IRFunctionReference*>(irInvoke->func);
+        auto* func = functionReference != nullptr
+                         ? llvmModule->getFunction(functionReference->function->name)
+                         : lowerOperand(irInvoke->func);
         std::vector<llvm::Value*> args;
-        for (auto* arg : irInvoke->arguments)
+        args.reserve(irInvoke->arguments.size());
+        for (auto* arg : irInvoke->arguments) args.push_back(lowerOperand(arg));
+        if (functionReference != nullptr)
         {
-            visit(arg, additional);
-            args.push_back(std::any_cast<llvm::Value*>(stack.top()));
-            stack.pop();
+            if (auto* builtin = lowerBuiltin(functionReference->function, args))
+            {
+                if (irInvoke->target != nullptr) register2Value[irInvoke->target] = builtin;
+                return nullptr;
+            }
         }
         auto* result = builder->CreateCall(funcType, func, args);
+        if (auto* callee = llvm::dyn_cast<llvm::Function>(func)) result->setCallingConv(callee->getCallingConv());
         if (irInvoke->target != nullptr)
         {
             register2Value[irInvoke->target] = result;
@@ -584,21 +1163,15 @@ namespace lg::llvm_ir_gen
         }
         else
         {
-            visit(irReturn->value, additional);
-            builder->CreateRet(std::any_cast<llvm::Value*>(stack.top()));
-            stack.pop();
+            builder->CreateRet(lowerOperand(irReturn->value));
         }
         return nullptr;
     }
 
     std::any LLVMIRGenerator::visitLoad(ir::instruction::IRLoad* irLoad, std::any additional)
     {
-        visit(dynamic_cast<ir::type::IRPointerType*>(irLoad->ptr->getType())->base, additional);
-        auto* ty = std::any_cast<llvm::Type*>(stack.top());
-        stack.pop();
-        visit(irLoad->ptr, additional);
-        auto* ptr = std::any_cast<llvm::Value*>(stack.top());
-        stack.pop();
+        auto* ty = lowerType(classifyType(irLoad->ptr->getType()).base);
+        auto* ptr = lowerOperand(irLoad->ptr);
         auto* result = builder->CreateLoad(ty, ptr);
         register2Value[irLoad->target] = result;
         return nullptr;
@@ -606,12 +1179,21 @@ namespace lg::llvm_ir_gen
 
     std::any LLVMIRGenerator::visitStore(ir::instruction::IRStore* irStore, std::any additional)
     {
-        visit(irStore->ptr, additional);
-        auto* ptr = std::any_cast<llvm::Value*>(stack.top());
-        stack.pop();
-        visit(irStore->value, additional);
-        auto* value = std::any_cast<llvm::Value*>(stack.top());
-        stack.pop();
+        auto* ptr = lowerOperand(irStore->ptr);
+        auto* value = lowerOperand(irStore->value);
+        // A structure or array copied by a load immediately followed by this store becomes a memcpy
+        // with a known size, which the backend can expand instead of moving a first-class aggregate.
+        auto* insertBlock = builder->GetInsertBlock();
+        if (auto* load = llvm::dyn_cast<llvm::LoadInst>(value);
+            load != nullptr && load->getType()->isAggregateType() && !insertBlock->empty() && &insertBlock->back() ==
+            load)
+        {
+            const auto& dataLayout = llvmModule->getDataLayout();
+            builder->CreateMemCpy(ptr, dataLayout.getABITypeAlign(load->getType()), load->getPointerOperand(),
+                                  load->getAlign(), dataLayout.getTypeStoreSize(load->getType()));
+            copiedAggregateLoads.push_back(load);
+            return nullptr;
+        }
         builder->CreateStore(value, ptr);
         return nullptr;
     }
@@ -623,28 +1205,14 @@ namespace lg::llvm_ir_gen
 
     std::any LLVMIRGenerator::visitSetRegister(ir::instruction::IRSetRegister* irSetRegister, std::any additional)
     {
-        visit(irSetRegister->value, additional);
-        register2Value[irSetRegister->target] = std::any_cast<llvm::Value*>(stack.top());
-        stack.pop();
+        register2Value[irSetRegister->target] = lowerOperand(irSetRegister->value);
         return nullptr;
     }
 
     std::any LLVMIRGenerator::visitStackAllocate(ir::instruction::IRStackAllocate* irStackAllocate, std::any additional)
     {
-        visit(irStackAllocate->type, additional);
-        auto* ty = std::any_cast<llvm::Type*>(stack.top());
-        stack.pop();
-        llvm::Value* size;
-        if (irStackAllocate->size != nullptr)
-        {
-            visit(irStackAllocate->size, additional);
-            size = std::any_cast<llvm::Value*>(stack.top());
-            stack.pop();
-        }
-        else
-        {
-            size = nullptr;
-        }
+        auto* ty = lowerType(irStackAllocate->type);
+        auto* size = irStackAllocate->size != nullptr ? lowerOperand(irStackAllocate->size) : nullptr;
         auto* result = builder->CreateAlloca(ty, size);
         register2Value[irStackAllocate->target] = result;
         return nullptr;
@@ -652,12 +1220,8 @@ namespace lg::llvm_ir_gen
 
     std::any LLVMIRGenerator::visitTypeCast(ir::instruction::IRTypeCast* irTypeCast, std::any additional)
     {
-        visit(irTypeCast->source, additional);
-        auto* source = std::any_cast<llvm::Value*>(stack.top());
-        stack.pop();
-        visit(irTypeCast->targetType, additional);
-        auto* targetType = std::any_cast<llvm::Type*>(stack.top());
-        stack.pop();
+        auto* source = lowerOperand(irTypeCast->source);
+        auto* targetType = lowerType(irTypeCast->targetType);
         llvm::Instruction::CastOps op;
         switch (irTypeCast->kind)
         {
@@ -671,13 +1235,13 @@ namespace lg::llvm_ir_gen
             op = llvm::Instruction::CastOps::Trunc;
             break;
         case ir::instruction::IRTypeCast::Kind::INTTOF:
-            if (dynamic_cast<ir::type::IRIntegerType*>(irTypeCast->source->getType())->_unsigned)
+            if (classifyType(irTypeCast->source->getType()).kind == TypeKind::UNSIGNED_INTEGER)
                 op = llvm::Instruction::CastOps::UIToFP;
             else
                 op = llvm::Instruction::CastOps::SIToFP;
             break;
         case ir::instruction::IRTypeCast::Kind::FTOINT:
-            if (dynamic_cast<ir::type::IRIntegerType*>(irTypeCast->targetType)->_unsigned)
+            if (classifyType(irTypeCast->targetType).kind == TypeKind::UNSIGNED_INTEGER)
                 op = llvm::Instruction::CastOps::FPToUI;
             else
                 op = llvm::Instruction::CastOps::FPToSI;
@@ -708,26 +1272,16 @@ namespace lg::llvm_ir_gen
 
     std::any LLVMIRGenerator::visitPhi(ir::instruction::IRPhi* irPhi, std::any additional)
     {
-        visit(irPhi->values.begin()->second->getType(), additional);
-        auto* ty = std::any_cast<llvm::Type*>(stack.top());
-        stack.pop();
+        auto* ty = lowerType(irPhi->values.begin()->second->getType());
         auto* phiInst = builder->CreatePHI(ty, irPhi->values.size());
-        for (auto& [block, value] : irPhi->values)
-        {
-            visit(value, additional);
-            auto* llvmVal = std::any_cast<llvm::Value*>(stack.top());
-            stack.pop();
-            phiInst->addIncoming(llvmVal, irBlock2LLVMBlock[block]);
-        }
+        for (auto& [block, value] : irPhi->values) phiInst->addIncoming(lowerOperand(value), irBlock2LLVMBlock[block]);
         register2Value[irPhi->target] = phiInst;
         return nullptr;
     }
 
     std::any LLVMIRGenerator::visitSwitch(ir::instruction::IRSwitch* irSwitch, std::any additional)
     {
-        visit(irSwitch->value, additional);
-        auto* val = std::any_cast<llvm::Value*>(stack.top());
-        stack.pop();
+        auto* val = lowerOperand(irSwitch->value);
         auto* switchInst = builder->CreateSwitch(val, irBlock2LLVMBlock[irSwitch->defaultCase],
                                                  irSwitch->cases.size());
         for (auto& [value, block] : irSwitch->cases)
@@ -739,6 +1293,9 @@ namespace lg::llvm_ir_gen
             if (!constantInt)throw std::runtime_error("Switch case value is not an integer constant");
             switchInst->addCase(constantInt, irBlock2LLVMBlock[block]);
         }
+        std::vector<llvm::BasicBlock*> successors(switchInst->successors().begin(), switchInst->successors().end());
+        if (auto* weights = createBranchWeights(successors))
+            switchInst->setMetadata(llvm::LLVMContext::MD_prof, weights);
         return nullptr;
     }
 
@@ -758,7 +1315,8 @@ namespace lg::llvm_ir_gen
     std::any LLVMIRGenerator::visitFunctionReference(ir::value::constant::IRFunctionReference* irFunctionReference,
                                                      std::any additional)
     {
-        stack.push(std::make_any<llvm::Value*>(llvmModule->getFunction(irFunctionReference->function->name)));
+        stack.push(std::make_any<llvm::Value*>(
+            getCEntryPoint(llvmModule->getFunction(irFunctionReference->function->name))));
         return nullptr;
     }
 
@@ -818,6 +1376,11 @@ namespace lg::llvm_ir_gen
         stack.pop();
         auto* arrayType = llvm::cast<llvm::ArrayType>(ty);
         if (arrayType == nullptr) throw std::runtime_error("Array constant type is not an array type");
+        if (auto* dataArray = createDataArray(arrayType, irArrayConstant->elements))
+        {
+            stack.push(std::make_any<llvm::Value*>(dataArray));
+            return nullptr;
+        }
         std::vector<llvm::Constant*> values;
         for (auto& value : irArrayConstant->elements)
         {
@@ -845,6 +1408,12 @@ namespace lg::llvm_ir_gen
             stack.pop();
             elements.push_back(llvm::cast<llvm::Constant>(llvmVal));
         }
+        if (const auto it = structureFieldPositions.find(structureType); it != structureFieldPositions.end())
+        {
+            std::vector<llvm::Constant*> ordered(elements.size());
+            for (size_t i = 0; i < elements.size(); ++i) ordered[it->second[i]] = elements[i];
+            elements = std::move(ordered);
+        }
         stack.push(std::make_any<llvm::Value*>(llvm::ConstantStruct::get(structureType, elements)));
         return nullptr;
     }
@@ -918,62 +1487,23 @@ namespace lg::llvm_ir_gen
         return nullptr;
     }
 
-    void compile(llvm::Module* module, std::string triple, std::string output)
+    void compile(llvm::Module* module, const CompileOptions& options, std::string output)
     {
-        std::string tmpFile = output + ".ll";
-        module->setTargetTriple(llvm::Triple(triple));
-        std::error_code EC;
-        llvm::raw_fd_ostream Out(tmpFile, EC);
-        if (EC)
-        {
-            throw std::runtime_error("Failed to open file: " + tmpFile);
-        }
-        module->print(Out, nullptr);
-        Out.flush();
-
-        clang::DiagnosticOptions DiagOpts;
-        llvm::IntrusiveRefCntPtr DiagID(new clang::DiagnosticIDs());
-        clang::DiagnosticsEngine Diags(DiagID, DiagOpts, new clang::TextDiagnosticPrinter(llvm::errs(), DiagOpts));
-
-        std::string ClangPath = "clang";
-        llvm::ErrorOr<std::string> ClangPathOrErr = llvm::sys::findProgramByName("clang");
-        if (ClangPathOrErr)
-        {
-            ClangPath = ClangPathOrErr.get();
-        }
-
-        clang::driver::Driver Driver(ClangPath, triple, Diags);
-
-        std::vector<std::string> args = {ClangPath, "-x", "ir", tmpFile};
-
-        auto addArg = [&args](const std::string& flag, const std::string& value = "")
-        {
-            args.emplace_back(flag);
-            if (!value.empty())
-            {
-                args.emplace_back(value);
-            }
-        };
-
-        addArg("-o", output);
-
-        std::vector<const char*> argsText;
-        for (const auto& arg : args)
-        {
-            argsText.push_back(arg.c_str());
-        }
-        argsText.push_back(nullptr);
-
-        const auto C = Driver.BuildCompilation(argsText);
-        llvm::SmallVector<std::pair<int, const clang::driver::Command*>, 4> Failing;
-        C->ExecuteJobs(C->getJobs(), Failing);
+        const auto targetMachine = prepareModule(module, options);
+        const auto functions = definedFunctionNames(module);
+        std::optional<RemarkSession> remarks;
+        if (!options.remarksFile.empty() || !options.remarksSummary.empty())
+            remarks.emplace(module->getContext(), options);
+        optimize(module, targetMachine.get(), options);
+        llvm::SmallVector<char, 0> object;
+        emitObject(module, targetMachine.get(), object);
+        if (remarks) remarks->finish();
+        linkObjects({llvm::StringRef(object.data(), object.size())}, toLinkOptions(options), output);
+        if (!options.sizeReport.empty()) writeSizeReport(output, functions, options.sizeReport);
+    }
 
-        if (llvm::sys::fs::exists(tmpFile))
-        {
-            if (std::error_code ec = llvm::sys::fs::remove(tmpFile))
-            {
-                llvm::errs() << "Failed to remove file: " << ec.message() << "\n";
-            }
-        }
+    void compile(llvm::Module* module, std::string triple, std::string output)
+    {
+        compile(module, CompileOptions{std::move(triple)}, std::move(output));
     }
 }
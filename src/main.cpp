@@ -3,10 +3,335 @@
 #include <lg/parser.h>
 #include <lg/dumper.h>
 
+#include "binary_ir.h"
+#include "ir_construction.h"
 #include "llvm_ir_gen.h"
+#include "tiered_jit.h"
 
-int main()
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/TargetParser/Host.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+static std::string readFile(const std::string& path)
+{
+    auto file = llvm::MemoryBuffer::getFile(path);
+    if (!file) throw std::runtime_error("Failed to open " + path + ": " + file.getError().message());
+    return (*file)->getBuffer().str();
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Times the text parser against loading the same module from the binary format.
+static void benchmarkLoad(const std::string& path)
+{
+    const auto code = readFile(path);
+    auto start = std::chrono::steady_clock::now();
+    const auto module = lg::ir::parser::parse(code);
+    const auto textTime = millisecondsSince(start);
+
+    llvm::SmallString<128> binaryPath;
+    if (const auto error = llvm::sys::fs::createTemporaryFile("lg", "lgb", binaryPath))
+        throw std::runtime_error("Failed to create temporary file: " + error.message());
+    lg::llvm_ir_gen::writeBinaryModule(module, binaryPath.str().str());
+
+    start = std::chrono::steady_clock::now();
+    lg::llvm_ir_gen::BinaryIRModule lazy(binaryPath.str().str());
+    const auto lazyTime = millisecondsSince(start);
+    lazy.loadAllFunctions();
+    const auto binaryTime = millisecondsSince(start);
+    llvm::sys::fs::remove(binaryPath);
+
+    std::cout << "text parse:           " << textTime << " ms" << std::endl;
+    std::cout << "binary load (lazy):   " << lazyTime << " ms" << std::endl;
+    std::cout << "binary load (bodies): " << binaryTime << " ms" << std::endl;
+}
+
+// Times LLVMIRGenerator::generate on a single function holding a chain of count dependent additions.
+static void benchmarkLowering(size_t count)
+{
+    std::string code = "function i32 main(){}{entry:\t%v0 = add i32 1, i32 2";
+    for (size_t i = 1; i < count; ++i)
+        code += "\t%v" + std::to_string(i) + " = add i32 %v" + std::to_string(i - 1) + ", i32 1";
+    code += "\treturn i32 %v" + std::to_string(count - 1) + "}";
+    const auto module = lg::ir::parser::parse(code);
+
+    llvm::LLVMContext context;
+    llvm::Module llvmModule("", context);
+    lg::llvm_ir_gen::LLVMIRGenerator generator(module, &context, &llvmModule);
+    const auto start = std::chrono::steady_clock::now();
+    generator.generate();
+    const auto time = millisecondsSince(start);
+    std::cout << "lowered " << count << " instructions in " << time << " ms ("
+        << time * 1e6 / static_cast<double>(count) << " ns/instruction)" << std::endl;
+}
+
+// Peak resident set size of this process in bytes, 0 where it is not available.
+static size_t peakResidentBytes()
+{
+#ifdef _WIN32
+    return 0;
+#else
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+// Times generating a module whose only global is a table of megabytes of i32 and reports the peak resident set
+// size. "elements" gives the table as an lg array constant, which the generator packs into one data array;
+// "embed" reads it from a file through embed(path); "constant-array" builds the same table the way array
+// constants used to be lowered, one ConstantInt per element and then ConstantArray::get. Each mode needs its
+// own process for the peaks to be comparable.
+static void benchmarkEmbed(const std::string& mode, size_t megabytes)
+{
+    using namespace lg::ir;
+    const size_t count = megabytes * 1024 * 1024 / sizeof(int32_t);
+    const auto element = [](size_t i) { return static_cast<uint32_t>(i * 2654435761u); };
+    llvm::LLVMContext context;
+    llvm::Module llvmModule("", context);
+    llvm::SmallString<128> blobPath;
+    std::function<void()> generate;
+    if (mode == "constant-array")
+    {
+        generate = [&]
+        {
+            auto* int32Type = llvm::Type::getInt32Ty(context);
+            auto* arrayType = llvm::ArrayType::get(int32Type, count);
+            std::vector<llvm::Constant*> elements;
+            elements.reserve(count);
+            for (size_t i = 0; i < count; ++i) elements.push_back(llvm::ConstantInt::get(int32Type, element(i)));
+            new llvm::GlobalVariable(llvmModule, arrayType, true, llvm::GlobalValue::ExternalLinkage,
+                                     llvm::ConstantArray::get(arrayType, elements), "table");
+        };
+    }
+    else
+    {
+        auto* elementType = lg::llvm_ir_gen::makeIntegerType(32, false);
+        auto* arrayType = lg::llvm_ir_gen::makeArrayType(elementType, count);
+        auto* module = lg::llvm_ir_gen::makeModule();
+        base::IRGlobalVariable* global;
+        if (mode == "embed")
+        {
+            if (const auto error = llvm::sys::fs::createTemporaryFile("lg-embed", "bin", blobPath))
+                throw std::runtime_error("Failed to create temporary file: " + error.message());
+            std::error_code error;
+            llvm::raw_fd_ostream out(blobPath, error);
+            if (error) throw std::runtime_error("Failed to open " + blobPath.str().str() + ": " + error.message());
+            std::vector<uint32_t> chunk(1024 * 1024 / sizeof(uint32_t));
+            for (size_t written = 0; written < count; written += chunk.size())
+            {
+                for (size_t i = 0; i < chunk.size(); ++i) chunk[i] = element(written + i);
+                out.write(reinterpret_cast<const char*>(chunk.data()),
+                          std::min(chunk.size(), count - written) * sizeof(uint32_t));
+            }
+            out.close();
+            global = lg::llvm_ir_gen::makeGlobalVariable({"embed(" + blobPath.str().str() + ")"}, true, "table",
+                                                         arrayType);
+        }
+        else if (mode == "elements")
+        {
+            decltype(value::constant::IRArrayConstant::elements) elements;
+            elements.reserve(count);
+            for (size_t i = 0; i < count; ++i)
+                elements.push_back(lg::llvm_ir_gen::makeIntegerConstant(elementType, element(i)));
+            global = lg::llvm_ir_gen::makeGlobalVariable({}, true, "table", arrayType);
+            global->initializer = lg::llvm_ir_gen::makeArrayConstant(arrayType, std::move(elements));
+        }
+        else
+        {
+            throw std::runtime_error("--bench-embed expects elements, embed or constant-array, not " + mode);
+        }
+        lg::llvm_ir_gen::addGlobalVariable(module, global);
+        generate = [&context, &llvmModule, module]
+        {
+            lg::llvm_ir_gen::LLVMIRGenerator generator(module, &context, &llvmModule);
+            generator.generate();
+        };
+    }
+
+    const auto residentBefore = peakResidentBytes();
+    const auto start = std::chrono::steady_clock::now();
+    generate();
+    const auto time = millisecondsSince(start);
+    const auto residentAfter = peakResidentBytes();
+    if (!blobPath.empty()) llvm::sys::fs::remove(blobPath);
+
+    constexpr double MEGABYTE = 1024 * 1024;
+    std::cout << mode << ": generated a " << megabytes << " MB table in " << time << " ms, peak RSS "
+        << static_cast<double>(residentAfter) / MEGABYTE << " MB ("
+        << static_cast<double>(residentAfter - residentBefore) / MEGABYTE << " MB added while generating)"
+        << std::endl;
+}
+
+// Builds the program at path once per counter mode and reports the best of runs wall-clock times, so the
+// cost of leaving counters on can be read off against the uninstrumented build.
+static void benchmarkCounters(const std::string& path, unsigned runs)
+{
+    const auto code = readFile(path);
+    llvm::SmallString<128> workDirectory;
+    if (const auto error = llvm::sys::fs::createUniqueDirectory("lg-counters", workDirectory))
+        throw std::runtime_error("Failed to create a work directory: " + error.message());
+    llvm::SmallString<128> countersFile(workDirectory);
+    llvm::sys::path::append(countersFile, "counters.txt");
+    // The binaries run with only LG_COUNTERS_FILE set so their dumps stay in the work directory.
+    const std::string environment = "LG_COUNTERS_FILE=" + countersFile.str().str();
+    const llvm::StringRef environmentVariables[] = {environment};
+    const std::optional<llvm::StringRef> redirects[] = {std::nullopt, llvm::StringRef(""), std::nullopt};
+
+    const std::pair<const char*, lg::llvm_ir_gen::CounterMode> modes[] = {
+        {"none", lg::llvm_ir_gen::CounterMode::NONE},
+        {"function", lg::llvm_ir_gen::CounterMode::FUNCTION},
+        {"basic block", lg::llvm_ir_gen::CounterMode::BASIC_BLOCK},
+    };
+    double baseline = 0;
+    for (const auto& [label, mode] : modes)
+    {
+        llvm::SmallString<128> binary(workDirectory);
+        llvm::sys::path::append(binary, label);
+        llvm::LLVMContext context;
+        llvm::Module llvmModule("", context);
+        lg::llvm_ir_gen::CompileOptions compileOptions;
+        compileOptions.triple = llvm::sys::getDefaultTargetTriple();
+        compileOptions.optLevel = 2;
+        lg::llvm_ir_gen::configureModule(&llvmModule, compileOptions);
+        lg::llvm_ir_gen::GeneratorOptions generatorOptions;
+        generatorOptions.counters = mode;
+        lg::llvm_ir_gen::LLVMIRGenerator generator(lg::ir::parser::parse(code), &context, &llvmModule,
+                                                   generatorOptions);
+        generator.generate();
+        lg::llvm_ir_gen::compile(&llvmModule, compileOptions, binary.str().str());
+
+        double best = 0;
+        for (unsigned run = 0; run < runs; ++run)
+        {
+            std::string error;
+            const auto start = std::chrono::steady_clock::now();
+            const auto status = llvm::sys::ExecuteAndWait(binary, {binary}, environmentVariables,
+                                                          redirects, 0, 0, &error);
+            const auto time = millisecondsSince(start);
+            if (status != 0)
+                throw std::runtime_error(binary.str().str() + " exited with status " + std::to_string(status) + " " +
+                                         error);
+            best = run == 0 ? time : std::min(best, time);
+        }
+        if (mode == lg::llvm_ir_gen::CounterMode::NONE) baseline = best;
+        std::cout << "counters " << label << ": " << best << " ms";
+        if (mode != lg::llvm_ir_gen::CounterMode::NONE && baseline > 0)
+            std::cout << " (" << (best - baseline) / baseline * 100 << "% overhead)";
+        std::cout << std::endl;
+    }
+    llvm::sys::fs::remove_directories(workDirectory);
+}
+
+// Runs the program's main through the tiered JIT, then reports which functions were recompiled at tier 1 and
+// how long that took. Returns main's result.
+static int runTiered(const std::string& path, uint64_t threshold, const std::string& cpu,
+                     const std::string& features)
+{
+    lg::llvm_ir_gen::TieredJITOptions options;
+    options.tierUpThreshold = threshold;
+    if (!cpu.empty()) options.cpu = cpu;
+    options.features = features;
+
+    auto context = std::make_unique<llvm::LLVMContext>();
+    auto llvmModule = std::make_unique<llvm::Module>("", *context);
+    lg::llvm_ir_gen::CompileOptions compileOptions;
+    compileOptions.triple = llvm::sys::getDefaultTargetTriple();
+    compileOptions.cpu = options.cpu;
+    compileOptions.features = options.features;
+    lg::llvm_ir_gen::configureModule(llvmModule.get(), compileOptions);
+    lg::llvm_ir_gen::LLVMIRGenerator generator(lg::ir::parser::parse(readFile(path)), context.get(),
+                                               llvmModule.get());
+    generator.generate();
+
+    lg::llvm_ir_gen::TieredJIT jit(std::move(context), std::move(llvmModule), options);
+    const auto status = jit.lookupFunction<int()>("main")();
+    jit.waitForPendingCompiles();
+
+    const auto statistics = jit.statistics();
+    std::cerr << "tiered JIT: " << statistics.tieredUp << " of " << statistics.tier0Functions
+        << " functions tiered up (" << statistics.failed << " failed), " << statistics.tier1CompileTime.count()
+        << " us compiling tier 1" << std::endl;
+    for (const auto& function : statistics.functions)
+    {
+        if (function.tier == 0) continue;
+        std::cerr << "  " << function.name << ": " << function.tierUpLatency.count() << " us to tier up"
+            << std::endl;
+    }
+    return status;
+}
+
+int main(int argc, char** argv)
 {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    // -mcpu= and -mattr= take the values of CompileOptions::cpu and features and may appear anywhere.
+    std::string cpu;
+    std::string features;
+    std::erase_if(args, [&](const std::string& arg)
+    {
+        llvm::StringRef value(arg);
+        if (value.consume_front("-mcpu=")) cpu = value.str();
+        else if (value.consume_front("-mattr=")) features = value.str();
+        else return false;
+        return true;
+    });
+    if (args.size() == 3 && args[0] == "--convert")
+    {
+        lg::llvm_ir_gen::convertTextToBinary(readFile(args[1]), args[2]);
+        return 0;
+    }
+    if (args.size() == 2 && args[0] == "--bench-load")
+    {
+        benchmarkLoad(args[1]);
+        return 0;
+    }
+    if ((args.size() == 2 || args.size() == 3) && args[0] == "--bench-counters")
+    {
+        benchmarkCounters(args[1], args.size() == 3 ? std::max<unsigned>(std::stoul(args[2]), 1) : 5);
+        return 0;
+    }
+    if ((args.size() == 2 || args.size() == 3) && args[0] == "--bench-embed")
+    {
+        benchmarkEmbed(args[1], args.size() == 3 ? std::max<size_t>(std::stoull(args[2]), 1) : 64);
+        return 0;
+    }
+    if ((args.size() == 2 || args.size() == 3) && args[0] == "--jit")
+    {
+        const auto threshold = lg::llvm_ir_gen::TieredJITOptions().tierUpThreshold;
+        return runTiered(args[1], args.size() == 3 ? std::stoull(args[2]) : threshold, cpu, features);
+    }
+    if (args.size() == 2 && args[0] == "--bench-lower")
+    {
+        benchmarkLowering(std::max<size_t>(std::stoull(args[1]), 1));
+        return 0;
+    }
+
+    // --layout-report prints the structure layout analysis before the generated IR.
+    const bool layoutReport = !args.empty() && args[0] == "--layout-report";
+    if (layoutReport) args.erase(args.begin());
+
     std::string code = "global aaa = i32 1 "
                        "const global bbb = i32 2"
                        "global structTest = constant structure A { i32 1, constant structure B { u64 2 } }"
@@ -38,17 +363,40 @@ int main()
                        "}"
                        "extern function i32 printf(u8* fmt, ...)"
                        "global f = string \"%d\n\"";
-    const auto module = lg::ir::parser::parse(code);
+    std::unique_ptr<lg::llvm_ir_gen::BinaryIRModule> binaryModule;
+    lg::ir::IRModule* module;
+    if (args.size() == 1 && llvm::StringRef(args[0]).ends_with(".lgb"))
+    {
+        // The dumper walks every body, so the driver loads them all; the generator alone could load lazily.
+        binaryModule = std::make_unique<lg::llvm_ir_gen::BinaryIRModule>(args[0]);
+        binaryModule->loadAllFunctions();
+        module = binaryModule->getModule();
+    }
+    else
+    {
+        module = lg::ir::parser::parse(args.size() == 1 ? readFile(args[0]) : code);
+    }
     std::cout << "==============LG IR============" << std::endl;
     lg::ir::IRDumper dumper;
     dumper.visitModule(module, std::string(""));
 
     llvm::LLVMContext context;
     const auto llvmModule = new llvm::Module("", context);
+    lg::llvm_ir_gen::CompileOptions compileOptions;
+    compileOptions.triple = llvm::sys::getDefaultTargetTriple();
+    compileOptions.cpu = cpu;
+    compileOptions.features = features;
+    lg::llvm_ir_gen::configureModule(llvmModule, compileOptions);
     lg::llvm_ir_gen::LLVMIRGenerator generator(module, &context, llvmModule);
     generator.generate();
+    if (layoutReport)
+    {
+        std::cout << "========STRUCTURE LAYOUT=======" << std::endl;
+        lg::llvm_ir_gen::printLayoutReport(llvm::outs(), generator.getStructureLayouts());
+        llvm::outs().flush();
+    }
     std::cout << "===========LLVM IR=============" << std::endl;
     llvmModule->print(llvm::outs(), nullptr);
-    lg::llvm_ir_gen::compile(llvmModule, "x86_64-pc-linux-gnu", "a.out");
+    lg::llvm_ir_gen::compile(llvmModule, compileOptions, "a.out");
     return 0;
 }
@@ -0,0 +1,139 @@
+#include <multi_target.h>
+
+#include <linker.h>
+#include <llvm_ir_gen.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Support/MemoryBufferRef.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/TargetParser/Triple.h>
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+namespace lg::llvm_ir_gen
+{
+    namespace
+    {
+        // Replaces the target-cpu and target-features stamped at generation time with the target's own. Only
+        // the features a multiversioned clone adds are kept, after the target's so that they win.
+        void retargetFunctions(llvm::Module* module, const std::string& cpu, const std::string& features)
+        {
+            for (auto& function : *module)
+            {
+                if (function.isDeclaration()) continue;
+                function.removeFnAttr("target-cpu");
+                if (!cpu.empty()) function.addFnAttr("target-cpu", cpu);
+                auto combined = features;
+                if (const auto cloneFeatures = function.getFnAttribute(CLONE_FEATURES_ATTRIBUTE).getValueAsString();
+                    !cloneFeatures.empty())
+                    combined = combined.empty() ? cloneFeatures.str() : combined + "," + cloneFeatures.str();
+                function.removeFnAttr("target-features");
+                if (!combined.empty()) function.addFnAttr("target-features", combined);
+            }
+        }
+
+        // target_clones variants and their ifunc resolver test x86 CPU feature bits, so no other architecture
+        // can be given the module.
+        bool isMultiversioned(const llvm::Module* module)
+        {
+            if (!module->ifunc_empty()) return true;
+            return std::ranges::any_of(*module, [](const llvm::Function& function)
+            {
+                return function.hasFnAttribute(CLONE_FEATURES_ATTRIBUTE);
+            });
+        }
+
+        void emitForTarget(llvm::StringRef bitcode, const CompileOptions& options, TargetObject& result)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            llvm::LLVMContext context;
+            auto module = llvm::parseBitcodeFile(llvm::MemoryBufferRef(bitcode, "lg"), context);
+            if (!module) throw std::runtime_error("Failed to reload module: " + llvm::toString(module.takeError()));
+
+            auto targetOptions = options;
+            targetOptions.triple = result.target.triple;
+            targetOptions.cpu = result.target.cpu;
+            targetOptions.features = result.target.features;
+            targetOptions.remarksFile.clear();
+            targetOptions.remarksSummary.clear();
+            targetOptions.sizeReport.clear();
+            retargetFunctions(module->get(), resolveCPU(targetOptions.cpu),
+                              resolveFeatures(targetOptions.cpu, targetOptions.features));
+            const auto targetMachine = prepareModule(module->get(), targetOptions);
+            optimize(module->get(), targetMachine.get(), targetOptions);
+            emitObject(module->get(), targetMachine.get(), result.object);
+            result.time = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start);
+        }
+    }
+
+    // An LLVMContext can't be shared between threads, so rather than cloning in place the module is written
+    // to bitcode once and each thread reads its own copy into a private context.
+    std::vector<TargetObject> emitForTargets(const llvm::Module* module, const std::vector<TargetSpec>& targets,
+                                             const CompileOptions& options)
+    {
+        if (isMultiversioned(module))
+        {
+            for (const auto& target : targets)
+            {
+                if (!llvm::Triple(target.triple).isX86())
+                    throw std::runtime_error(target.triple + ": the module has target_clones variants or ifuncs, "
+                                             "which are only supported on x86 targets");
+            }
+        }
+
+        llvm::SmallVector<char, 0> bitcode;
+        llvm::raw_svector_ostream out(bitcode);
+        llvm::WriteBitcodeToFile(*module, out);
+        const llvm::StringRef bitcodeRef(bitcode.data(), bitcode.size());
+
+        std::vector<TargetObject> results(targets.size());
+        std::vector<std::exception_ptr> errors(targets.size());
+        std::vector<std::thread> threads;
+        threads.reserve(targets.size());
+        for (size_t i = 0; i < targets.size(); ++i)
+        {
+            results[i].target = targets[i];
+            threads.emplace_back([&, i]
+            {
+                try
+                {
+                    emitForTarget(bitcodeRef, options, results[i]);
+                }
+                catch (...)
+                {
+                    errors[i] = std::current_exception();
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        for (size_t i = 0; i < targets.size(); ++i)
+        {
+            if (!errors[i]) continue;
+            try
+            {
+                std::rethrow_exception(errors[i]);
+            }
+            catch (const std::exception& e)
+            {
+                throw std::runtime_error(targets[i].triple + ": " + e.what());
+            }
+        }
+        return results;
+    }
+
+    void compileForTargets(const llvm::Module* module, const std::vector<TargetSpec>& targets,
+                           const CompileOptions& options)
+    {
+        for (const auto& result : emitForTargets(module, targets, options))
+        {
+            auto linkOptions = toLinkOptions(options);
+            linkOptions.triple = result.target.triple;
+            linkObjects({llvm::StringRef(result.object.data(), result.object.size())}, linkOptions,
+                        result.target.output);
+        }
+    }
+}
@@ -0,0 +1,127 @@
+#include <llvm_ir_gen.h>
+#include <attributes.h>
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/IR/GlobalIFunc.h>
+#include <llvm/TargetParser/X86TargetParser.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <algorithm>
+#include <ranges>
+
+namespace lg::llvm_ir_gen
+{
+    namespace
+    {
+        // Mirrors clang's lowering of __builtin_cpu_supports: the feature bits live in the first word of
+        // __cpu_model.__cpu_features and in __cpu_features2, both filled in by __cpu_indicator_init.
+        llvm::Value* emitCpuSupports(llvm::IRBuilder<>& builder, llvm::Module* module,
+                                     const std::array<uint32_t, 4>& mask)
+        {
+            auto* int32Type = builder.getInt32Ty();
+            llvm::Value* result = builder.getTrue();
+            if (mask[0] != 0)
+            {
+                auto* cpuModelType = llvm::StructType::get(int32Type, int32Type, int32Type,
+                                                           llvm::ArrayType::get(int32Type, 1));
+                auto* cpuModel = llvm::cast<llvm::GlobalValue>(module->getOrInsertGlobal("__cpu_model", cpuModelType));
+                cpuModel->setDSOLocal(true);
+                auto* features = builder.CreateAlignedLoad(
+                    int32Type,
+                    builder.CreateInBoundsGEP(cpuModelType, cpuModel,
+                                              {builder.getInt32(0), builder.getInt32(3), builder.getInt32(0)}),
+                    llvm::MaybeAlign(4));
+                auto* bits = builder.getInt32(mask[0]);
+                result = builder.CreateAnd(result, builder.CreateICmpEQ(builder.CreateAnd(features, bits), bits));
+            }
+            auto* features2Type = llvm::ArrayType::get(int32Type, 3);
+            for (size_t i = 1; i < mask.size(); ++i)
+            {
+                if (mask[i] == 0) continue;
+                auto* cpuFeatures2 = llvm::cast<llvm::GlobalValue>(
+                    module->getOrInsertGlobal("__cpu_features2", features2Type));
+                cpuFeatures2->setDSOLocal(true);
+                auto* features = builder.CreateAlignedLoad(
+                    int32Type,
+                    builder.CreateInBoundsGEP(features2Type, cpuFeatures2,
+                                              {builder.getInt32(0), builder.getInt32(i - 1)}),
+                    llvm::MaybeAlign(4));
+                auto* bits = builder.getInt32(mask[i]);
+                result = builder.CreateAnd(result, builder.CreateICmpEQ(builder.CreateAnd(features, bits), bits));
+            }
+            return result;
+        }
+    }
+
+    // Functions marked `target_clones(avx512f+avx512bw, avx2+fma, ...)` get one clone per listed feature set
+    // plus the original as the default. The lg name becomes an ifunc whose resolver picks the first clone,
+    // in the listed order, that the running CPU supports.
+    void LLVMIRGenerator::emitMultiversionedFunctions()
+    {
+        for (const auto& irFunction : module->functions | std::views::values)
+        {
+            if (irFunction->isExtern) continue;
+            const auto targetClones = findAttributes(irFunction->attributes, "target_clones");
+            if (targetClones.empty()) continue;
+            const auto& triple = llvmModule->getTargetTriple();
+            if (!triple.isX86())
+                throw std::runtime_error(
+                    "target_clones on " + irFunction->name + " requires an x86 target triple on the module");
+            // The dispatch goes through an ifunc, which only ELF can express.
+            if (!triple.isOSBinFormatELF())
+                throw std::runtime_error("target_clones on " + irFunction->name + " requires an ELF target, not " +
+                                         triple.str());
+
+            auto* defaultFunction = llvmModule->getFunction(irFunction->name);
+            const auto baseFeatures = defaultFunction->getFnAttribute("target-features").getValueAsString().str();
+            defaultFunction->setName(irFunction->name + ".default");
+
+            std::vector<std::pair<llvm::Function*, std::array<uint32_t, 4>>> variants;
+            for (const auto& featureSet : targetClones.front().arguments)
+            {
+                llvm::SmallVector<llvm::StringRef> features;
+                llvm::StringRef(featureSet).split(features, '+', -1, false);
+                const auto mask = llvm::X86::getCpuSupportsMask(features);
+                if (std::ranges::all_of(mask, [](uint32_t bits) { return bits == 0; }))
+                    throw std::runtime_error(
+                        "unknown CPU feature set " + featureSet + " in target_clones of " + irFunction->name);
+
+                llvm::ValueToValueMapTy valueMap;
+                auto* clone = llvm::CloneFunction(defaultFunction, valueMap);
+                clone->setName(irFunction->name + "." + llvm::join(features, "_"));
+                std::vector<std::string> cloneFeatures;
+                for (const auto& feature : features) cloneFeatures.push_back("+" + feature.str());
+                clone->addFnAttr(CLONE_FEATURES_ATTRIBUTE, llvm::join(cloneFeatures, ","));
+                clone->addFnAttr("target-features", baseFeatures.empty()
+                                                        ? llvm::join(cloneFeatures, ",")
+                                                        : baseFeatures + "," + llvm::join(cloneFeatures, ","));
+                clone->setLinkage(llvm::GlobalValue::InternalLinkage);
+                variants.emplace_back(clone, mask);
+            }
+
+            auto* resolver = llvm::Function::Create(llvm::FunctionType::get(builder->getPtrTy(), false),
+                                                    llvm::GlobalValue::InternalLinkage,
+                                                    irFunction->name + ".resolver", llvmModule);
+            auto* ifunc = llvm::GlobalIFunc::create(defaultFunction->getFunctionType(), 0,
+                                                    llvm::GlobalValue::ExternalLinkage, irFunction->name, resolver,
+                                                    llvmModule);
+            defaultFunction->replaceAllUsesWith(ifunc);
+            defaultFunction->setLinkage(llvm::GlobalValue::InternalLinkage);
+
+            llvm::IRBuilder<> resolverBuilder(llvm::BasicBlock::Create(*context, "entry", resolver));
+            auto* cpuInit = llvm::cast<llvm::Function>(llvmModule->getOrInsertFunction(
+                "__cpu_indicator_init", llvm::FunctionType::get(resolverBuilder.getVoidTy(), false)).getCallee());
+            cpuInit->setDSOLocal(true);
+            resolverBuilder.CreateCall(cpuInit);
+            for (const auto& [clone, mask] : variants)
+            {
+                auto* selected = llvm::BasicBlock::Create(*context, "select", resolver);
+                auto* next = llvm::BasicBlock::Create(*context, "next", resolver);
+                resolverBuilder.CreateCondBr(emitCpuSupports(resolverBuilder, llvmModule, mask), selected, next);
+                resolverBuilder.SetInsertPoint(selected);
+                resolverBuilder.CreateRet(clone);
+                resolverBuilder.SetInsertPoint(next);
+            }
+            resolverBuilder.CreateRet(defaultFunction);
+        }
+    }
+}
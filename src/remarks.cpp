@@ -0,0 +1,170 @@
+#include <remarks.h>
+
+#include <llvm/CodeGen/MachineBasicBlock.h>
+#include <llvm/CodeGen/MachineOptimizationRemarkEmitter.h>
+#include <llvm/IR/DiagnosticInfo.h>
+#include <llvm/IR/LLVMRemarkStreamer.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Regex.h>
+
+#include <map>
+#include <stdexcept>
+
+namespace lg::llvm_ir_gen
+{
+    namespace
+    {
+        class RemarkCollector : public llvm::DiagnosticHandler
+        {
+        private:
+            std::shared_ptr<std::vector<Remark>> remarks;
+            std::optional<llvm::Regex> filter;
+
+            bool enabled(llvm::StringRef passName) const
+            {
+                return !filter || filter->match(passName);
+            }
+
+            static Remark::Kind kindOf(const llvm::DiagnosticInfoOptimizationBase& remark)
+            {
+                if (remark.isPassed()) return Remark::Kind::PASSED;
+                if (remark.isMissed()) return Remark::Kind::MISSED;
+                return Remark::Kind::ANALYSIS;
+            }
+
+        public:
+            RemarkCollector(std::shared_ptr<std::vector<Remark>> remarks, const std::string& filter)
+                : remarks(std::move(remarks))
+            {
+                if (filter.empty()) return;
+                this->filter.emplace(filter);
+                std::string error;
+                if (!this->filter->isValid(error))
+                    throw std::runtime_error("invalid remarks filter " + filter + ": " + error);
+            }
+
+            bool isAnalysisRemarkEnabled(llvm::StringRef passName) const override
+            {
+                return enabled(passName);
+            }
+
+            bool isMissedOptRemarkEnabled(llvm::StringRef passName) const override
+            {
+                return enabled(passName);
+            }
+
+            bool isPassedOptRemarkEnabled(llvm::StringRef passName) const override
+            {
+                return enabled(passName);
+            }
+
+            bool isAnyRemarkEnabled() const override
+            {
+                return true;
+            }
+
+            // visitFunction names LLVM blocks after the lg blocks, so the code region maps straight back.
+            bool handleDiagnostics(const llvm::DiagnosticInfo& info) override
+            {
+                if (const auto* remark = llvm::dyn_cast<llvm::DiagnosticInfoIROptimization>(&info))
+                {
+                    if (!enabled(remark->getPassName())) return true;
+                    std::string block;
+                    if (const auto* region = llvm::dyn_cast_or_null<llvm::BasicBlock>(remark->getCodeRegion()))
+                        block = region->getName().str();
+                    remarks->push_back({
+                        kindOf(*remark), remark->getPassName(), remark->getRemarkName().str(),
+                        remark->getFunction().getName().str(), block, remark->getMsg()
+                    });
+                    return true;
+                }
+                if (const auto* remark = llvm::dyn_cast<llvm::DiagnosticInfoMIROptimization>(&info))
+                {
+                    if (!enabled(remark->getPassName())) return true;
+                    std::string block;
+                    if (const auto* machineBlock = remark->getBlock())
+                        if (const auto* basicBlock = machineBlock->getBasicBlock())
+                            block = basicBlock->getName().str();
+                    remarks->push_back({
+                        kindOf(*remark), remark->getPassName(), remark->getRemarkName().str(),
+                        remark->getFunction().getName().str(), block, remark->getMsg()
+                    });
+                    return true;
+                }
+                return false;
+            }
+        };
+
+        void printRemark(llvm::raw_ostream& out, const Remark& remark)
+        {
+            out << "  " << remark.function;
+            if (!remark.block.empty()) out << ":" << remark.block;
+            out << "  " << remark.pass << "/" << remark.name << ": " << remark.message << "\n";
+        }
+    }
+
+    RemarkSession::RemarkSession(llvm::LLVMContext& context, const CompileOptions& options)
+        : context(context), summaryPath(options.remarksSummary), remarks(std::make_shared<std::vector<Remark>>())
+    {
+        previousHandler = context.getDiagnosticHandler();
+        context.setDiagnosticHandler(std::make_unique<RemarkCollector>(remarks, options.remarksFilter));
+        auto remarksOutput = llvm::setupLLVMOptimizationRemarks(context, options.remarksFile, options.remarksFilter,
+                                                                options.remarksFormat,
+                                                                options.pgo == PGOMode::USE);
+        if (!remarksOutput)
+        {
+            context.setDiagnosticHandler(std::move(previousHandler));
+            throw std::runtime_error(llvm::toString(remarksOutput.takeError()));
+        }
+        output = std::move(*remarksOutput);
+    }
+
+    RemarkSession::~RemarkSession()
+    {
+        context.setLLVMRemarkStreamer(nullptr);
+        context.setMainRemarkStreamer(nullptr);
+        context.setDiagnosticHandler(std::move(previousHandler));
+    }
+
+    const std::vector<Remark>& RemarkSession::getRemarks() const
+    {
+        return *remarks;
+    }
+
+    void RemarkSession::writeSummary(llvm::raw_ostream& out) const
+    {
+        std::map<Remark::Kind, size_t> counts;
+        std::vector<const Remark*> vectorization;
+        std::vector<const Remark*> inlining;
+        for (const auto& remark : *remarks)
+        {
+            ++counts[remark.kind];
+            if (remark.kind == Remark::Kind::PASSED) continue;
+            if (remark.pass == "loop-vectorize" || remark.pass == "slp-vectorizer")
+                vectorization.push_back(&remark);
+            else if (remark.pass == "inline" && remark.kind == Remark::Kind::MISSED)
+                inlining.push_back(&remark);
+        }
+        out << "remarks: " << counts[Remark::Kind::PASSED] << " passed, " << counts[Remark::Kind::MISSED]
+            << " missed, " << counts[Remark::Kind::ANALYSIS] << " analysis\n";
+        out << "missed vectorization (" << vectorization.size() << "):\n";
+        for (const auto* remark : vectorization) printRemark(out, *remark);
+        out << "inlining failures (" << inlining.size() << "):\n";
+        for (const auto* remark : inlining) printRemark(out, *remark);
+    }
+
+    void RemarkSession::finish()
+    {
+        if (output) output->keep();
+        if (summaryPath.empty()) return;
+        if (summaryPath == "-")
+        {
+            writeSummary(llvm::outs());
+            return;
+        }
+        std::error_code error;
+        llvm::raw_fd_ostream out(summaryPath, error, llvm::sys::fs::OF_Text);
+        if (error) throw std::runtime_error("Failed to open " + summaryPath + ": " + error.message());
+        writeSummary(out);
+    }
+}
@@ -0,0 +1,104 @@
+#include <size_report.h>
+
+#include <llvm/Object/ObjectFile.h>
+#include <llvm/Object/SymbolSize.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Format.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace lg::llvm_ir_gen
+{
+    namespace
+    {
+        template <typename T>
+        std::optional<T> valueOrNone(llvm::Expected<T> value)
+        {
+            if (!value)
+            {
+                llvm::consumeError(value.takeError());
+                return std::nullopt;
+            }
+            return std::move(*value);
+        }
+    }
+
+    std::vector<FunctionSize> measureFunctionSizes(const std::string& binary, const std::vector<std::string>& functions)
+    {
+        auto file = llvm::object::ObjectFile::createObjectFile(binary);
+        if (!file) throw std::runtime_error("Failed to read " + binary + ": " + llvm::toString(file.takeError()));
+
+        std::unordered_map<std::string, std::pair<uint64_t, uint64_t>> symbols;
+        for (const auto& [symbol, size] : llvm::object::computeSymbolSizes(*file->getBinary()))
+        {
+            const auto type = valueOrNone(symbol.getType());
+            if (!type || *type != llvm::object::SymbolRef::ST_Function) continue;
+            const auto name = valueOrNone(symbol.getName());
+            const auto address = valueOrNone(symbol.getAddress());
+            if (!name || !address) continue;
+            symbols.try_emplace(name->str(), *address, size);
+        }
+
+        std::unordered_map<uint64_t, std::string> owners;
+        std::vector<FunctionSize> sizes;
+        for (const auto& function : functions)
+        {
+            const auto it = symbols.find(function);
+            if (it == symbols.end())
+            {
+                sizes.push_back({function, std::nullopt, ""});
+                continue;
+            }
+            const auto [address, size] = it->second;
+            const auto [owner, inserted] = owners.try_emplace(address, function);
+            sizes.push_back({function, size, inserted ? "" : owner->second});
+        }
+        std::ranges::stable_sort(sizes, [](const FunctionSize& a, const FunctionSize& b)
+        {
+            return a.size.value_or(0) > b.size.value_or(0);
+        });
+        return sizes;
+    }
+
+    void printSizeReport(llvm::raw_ostream& out, const std::vector<FunctionSize>& sizes)
+    {
+        uint64_t total = 0;
+        size_t emitted = 0;
+        for (const auto& function : sizes)
+        {
+            if (!function.size)
+            {
+                out << llvm::format("%10s  %s (removed)\n", "-", function.name.c_str());
+                continue;
+            }
+            const auto size = static_cast<unsigned long long>(*function.size);
+            if (!function.foldedInto.empty())
+            {
+                out << llvm::format("%10llu  %s (folded into %s)\n", size, function.name.c_str(),
+                                    function.foldedInto.c_str());
+                continue;
+            }
+            out << llvm::format("%10llu  %s\n", size, function.name.c_str());
+            total += *function.size;
+            ++emitted;
+        }
+        out << "total: " << total << " bytes in " << emitted << " functions\n";
+    }
+
+    void writeSizeReport(const std::string& binary, const std::vector<std::string>& functions,
+                         const std::string& path)
+    {
+        const auto sizes = measureFunctionSizes(binary, functions);
+        if (path == "-")
+        {
+            printSizeReport(llvm::outs(), sizes);
+            return;
+        }
+        std::error_code error;
+        llvm::raw_fd_ostream out(path, error, llvm::sys::fs::OF_Text);
+        if (error) throw std::runtime_error("Failed to open " + path + ": " + error.message());
+        printSizeReport(out, sizes);
+    }
+}
@@ -0,0 +1,146 @@
+#include <thin_lto.h>
+#include <codegen.h>
+#include <linker.h>
+
+#include <llvm/Analysis/ModuleSummaryAnalysis.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/LTO/LTO.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/CachePruning.h>
+#include <llvm/Support/Caching.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Threading.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace lg::llvm_ir_gen
+{
+    namespace
+    {
+        template <typename T>
+        T check(llvm::Expected<T> value)
+        {
+            if (!value) throw std::runtime_error(llvm::toString(value.takeError()));
+            return std::move(*value);
+        }
+
+        void check(llvm::Error error)
+        {
+            if (error) throw std::runtime_error(llvm::toString(std::move(error)));
+        }
+
+        llvm::SmallVector<char, 0> writeSummaryBitcode(llvm::Module* module, llvm::TargetMachine* targetMachine,
+                                                       unsigned optLevel)
+        {
+            llvm::LoopAnalysisManager LAM;
+            llvm::FunctionAnalysisManager FAM;
+            llvm::CGSCCAnalysisManager CGAM;
+            llvm::ModuleAnalysisManager MAM;
+            llvm::PassBuilder passBuilder(targetMachine);
+            passBuilder.registerModuleAnalyses(MAM);
+            passBuilder.registerCGSCCAnalyses(CGAM);
+            passBuilder.registerFunctionAnalyses(FAM);
+            passBuilder.registerLoopAnalyses(LAM);
+            passBuilder.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+            llvm::ModulePassManager MPM = optLevel == 0
+                                              ? passBuilder.buildO0DefaultPipeline(
+                                                  llvm::OptimizationLevel::O0, llvm::ThinOrFullLTOPhase::ThinLTOPreLink)
+                                              : passBuilder.buildThinLTOPreLinkDefaultPipeline(
+                                                  toOptimizationLevel(optLevel));
+            MPM.run(*module, MAM);
+
+            auto& index = MAM.getResult<llvm::ModuleSummaryIndexAnalysis>(*module);
+            llvm::SmallVector<char, 0> buffer;
+            llvm::raw_svector_ostream out(buffer);
+            llvm::WriteBitcodeToFile(*module, out, false, &index);
+            return buffer;
+        }
+    }
+
+    void compileThinLTO(const std::vector<llvm::Module*>& modules, const ThinLTOOptions& options, std::string output)
+    {
+        const auto cpu = resolveCPU(options.cpu);
+        const auto features = resolveFeatures(options.cpu, options.features);
+        const auto targetMachine = createTargetMachine(options.triple, cpu, features, options.optLevel);
+
+        std::vector<llvm::SmallVector<char, 0>> bitcodes;
+        std::vector<std::string> identifiers;
+        for (size_t i = 0; i < modules.size(); ++i)
+        {
+            auto* module = modules[i];
+            module->setTargetTriple(llvm::Triple(options.triple));
+            module->setDataLayout(targetMachine->createDataLayout());
+            bitcodes.push_back(writeSummaryBitcode(module, targetMachine.get(), options.optLevel));
+            identifiers.push_back(std::to_string(i) + ":" + module->getModuleIdentifier());
+        }
+
+        llvm::lto::Config config;
+        config.CPU = cpu;
+        if (!features.empty())
+        {
+            llvm::SmallVector<llvm::StringRef> attributes;
+            llvm::StringRef(features).split(attributes, ',', -1, false);
+            for (const auto& attribute : attributes) config.MAttrs.push_back(attribute.str());
+        }
+        config.DefaultTriple = options.triple;
+        config.RelocModel = llvm::Reloc::PIC_;
+        config.OptLevel = options.optLevel;
+        config.CGOptLevel = llvm::CodeGenOpt::getLevel(static_cast<int>(std::min(options.optLevel, 3u))).value_or(
+            llvm::CodeGenOptLevel::Default);
+        llvm::lto::LTO lto(std::move(config),
+                           llvm::lto::createInProcessThinBackend(llvm::heavyweight_hardware_concurrency(options.jobs)));
+
+        const std::unordered_set<std::string> exported(options.exportedSymbols.begin(), options.exportedSymbols.end());
+        std::unordered_set<std::string> prevailing;
+        for (size_t i = 0; i < bitcodes.size(); ++i)
+        {
+            auto input = check(llvm::lto::InputFile::create(
+                llvm::MemoryBufferRef(llvm::StringRef(bitcodes[i].data(), bitcodes[i].size()), identifiers[i])));
+            std::vector<llvm::lto::SymbolResolution> resolutions;
+            for (const auto& symbol : input->symbols())
+            {
+                llvm::lto::SymbolResolution resolution;
+                if (!symbol.isUndefined())
+                {
+                    resolution.Prevailing = prevailing.insert(symbol.getName().str()).second;
+                    resolution.FinalDefinitionInLinkageUnit = true;
+                    resolution.VisibleToRegularObj = exported.contains(symbol.getName().str()) || symbol.isUsed();
+                }
+                resolutions.push_back(resolution);
+            }
+            check(lto.add(std::move(input), resolutions));
+        }
+
+        std::vector<llvm::SmallString<0>> objects(lto.getMaxTasks());
+        auto addStream = [&objects](unsigned task, const llvm::Twine&)
+            -> llvm::Expected<std::unique_ptr<llvm::CachedFileStream>>
+        {
+            return std::make_unique<llvm::CachedFileStream>(std::make_unique<llvm::raw_svector_ostream>(objects[task]));
+        };
+        llvm::FileCache cache;
+        if (!options.cacheDir.empty())
+        {
+            auto addBuffer = [&objects](unsigned task, const llvm::Twine&, std::unique_ptr<llvm::MemoryBuffer> buffer)
+            {
+                objects[task] = buffer->getBuffer();
+            };
+            cache = check(llvm::localCache("ThinLTO", "Thin", options.cacheDir, addBuffer));
+        }
+        check(lto.run(addStream, cache));
+        if (!options.cacheDir.empty())
+        {
+            llvm::pruneCache(options.cacheDir, check(llvm::parseCachePruningPolicy("")));
+        }
+
+        std::vector<llvm::StringRef> objectRefs;
+        for (const auto& object : objects)
+        {
+            if (!object.empty()) objectRefs.emplace_back(object);
+        }
+        linkObjects(objectRefs, {options.linker, options.triple}, output);
+    }
+}
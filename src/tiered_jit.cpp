@@ -0,0 +1,283 @@
+#include <tiered_jit.h>
+#include <codegen.h>
+
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/WithColor.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace lg::llvm_ir_gen
+{
+    namespace
+    {
+        constexpr const char* TIER_UP_FUNCTION = "__lg_tier_up";
+
+        template <typename T>
+        T check(llvm::Expected<T> value)
+        {
+            if (!value) throw std::runtime_error(llvm::toString(value.takeError()));
+            return std::move(*value);
+        }
+
+        void check(llvm::Error error)
+        {
+            if (error) throw std::runtime_error(llvm::toString(std::move(error)));
+        }
+
+        // Tier-1 modules are compiled separately and must see every symbol of the tier-0 module.
+        void promoteLocals(llvm::Module* module)
+        {
+            for (auto& global : module->global_values())
+            {
+                if (!global.hasLocalLinkage()) continue;
+                if (!global.hasName()) global.setName("__lg_anonymous");
+                global.setLinkage(llvm::GlobalValue::ExternalLinkage);
+                global.setVisibility(llvm::GlobalValue::HiddenVisibility);
+            }
+        }
+    }
+
+    TieredJIT::TieredJIT(std::unique_ptr<llvm::LLVMContext> context, std::unique_ptr<llvm::Module> module,
+                         TieredJITOptions options) : options(std::move(options))
+    {
+        initializeTargets();
+        auto targetMachineBuilder = check(llvm::orc::JITTargetMachineBuilder::detectHost());
+        cpu = resolveCPU(this->options.cpu);
+        features = resolveFeatures(this->options.cpu, this->options.features);
+        targetMachineBuilder.setCPU(cpu);
+        targetMachineBuilder.getFeatures() = llvm::SubtargetFeatures(features);
+        targetMachineBuilder.setCodeGenOptLevel(llvm::CodeGenOptLevel::None);
+        triple = targetMachineBuilder.getTargetTriple().str();
+
+        jit = check(llvm::orc::LLJITBuilder().setJITTargetMachineBuilder(std::move(targetMachineBuilder)).create());
+        stubsManager = llvm::orc::createLocalIndirectStubsManagerBuilder(llvm::Triple(triple))();
+        if (!stubsManager) throw std::runtime_error("No indirect stubs support for " + triple);
+
+        if (!module->ifunc_empty()) throw std::runtime_error("target_clones is not supported by the tiered JIT");
+        module->setTargetTriple(llvm::Triple(triple));
+        module->setDataLayout(jit->getDataLayout());
+        promoteLocals(module.get());
+        llvm::raw_svector_ostream out(bitcode);
+        llvm::WriteBitcodeToFile(*module, out);
+
+        instrumentTier0(module.get());
+
+        llvm::orc::SymbolMap symbols;
+        for (const auto& function : functions)
+            symbols[jit->mangleAndIntern(function->name)] = stubsManager->findStub(function->name, false);
+        symbols[jit->mangleAndIntern(TIER_UP_FUNCTION)] = {
+            llvm::orc::ExecutorAddr::fromPtr(&TieredJIT::tierUpEntry), llvm::JITSymbolFlags::Exported
+        };
+        check(jit->getMainJITDylib().define(llvm::orc::absoluteSymbols(std::move(symbols))));
+        check(jit->addIRModule(llvm::orc::ThreadSafeModule(std::move(module), std::move(context))));
+        for (const auto& function : functions)
+            check(stubsManager->updatePointer(function->name, check(jit->lookup(function->name + ".tier0"))));
+        check(jit->initialize(jit->getMainJITDylib()));
+
+        worker = std::thread([this] { runWorker(); });
+    }
+
+    TieredJIT::~TieredJIT()
+    {
+        {
+            std::lock_guard lock(queueMutex);
+            stopping = true;
+        }
+        queueCondition.notify_all();
+        worker.join();
+        if (auto error = jit->deinitialize(jit->getMainJITDylib()))
+            llvm::WithColor::warning() << llvm::toString(std::move(error)) << "\n";
+    }
+
+    // Every defined function F becomes F.tier0 behind a stub named F, so all calls, including those from
+    // other JIT'd code and from the host, go through the stub. The body counts its calls and reports the
+    // threshold crossing to the host exactly once.
+    void TieredJIT::instrumentTier0(llvm::Module* module)
+    {
+        auto& context = module->getContext();
+        llvm::IRBuilder<> builder(context);
+        auto* int64Type = builder.getInt64Ty();
+        const auto tierUpFunction = module->getOrInsertFunction(
+            TIER_UP_FUNCTION, llvm::FunctionType::get(builder.getVoidTy(), {builder.getPtrTy(), int64Type}, false));
+        auto* self = llvm::ConstantExpr::getIntToPtr(builder.getInt64(reinterpret_cast<uint64_t>(this)),
+                                                     builder.getPtrTy());
+        const auto threshold = std::max<uint64_t>(options.tierUpThreshold, 1);
+
+        std::vector<llvm::Function*> bodies;
+        for (auto& function : *module)
+            if (!function.isDeclaration() && !function.getName().starts_with("__lg_")) bodies.push_back(&function);
+
+        for (auto* body : bodies)
+        {
+            const auto name = body->getName().str();
+            const auto index = functions.size();
+            functions.push_back(std::make_unique<FunctionState>());
+            functions.back()->name = name;
+
+            body->setName(name + ".tier0");
+            auto* stub = llvm::Function::Create(body->getFunctionType(), llvm::GlobalValue::ExternalLinkage, name,
+                                                module);
+            stub->setCallingConv(body->getCallingConv());
+            stub->setAttributes(body->getAttributes());
+            body->replaceAllUsesWith(stub);
+
+            auto* callCount = new llvm::GlobalVariable(*module, int64Type, false,
+                                                       llvm::GlobalValue::InternalLinkage,
+                                                       llvm::ConstantInt::get(int64Type, 0),
+                                                       "__lg_tier_count." + name);
+            auto& entry = body->getEntryBlock();
+            builder.SetInsertPoint(&entry, entry.getFirstNonPHIOrDbgOrAlloca());
+            auto* previous = builder.CreateAtomicRMW(llvm::AtomicRMWInst::Add, callCount, builder.getInt64(1),
+                                                     llvm::MaybeAlign(8), llvm::AtomicOrdering::Monotonic);
+            auto* crossed = llvm::cast<llvm::Instruction>(
+                builder.CreateICmpEQ(previous, builder.getInt64(threshold - 1)));
+            auto* tierUp = llvm::SplitBlockAndInsertIfThen(crossed, crossed->getNextNode(), false,
+                                                           llvm::MDBuilder(context).createUnlikelyBranchWeights());
+            builder.SetInsertPoint(tierUp);
+            builder.CreateCall(tierUpFunction, {self, builder.getInt64(index)});
+
+            check(stubsManager->createStub(name, llvm::orc::ExecutorAddr(), llvm::JITSymbolFlags::Exported));
+        }
+    }
+
+    void TieredJIT::tierUpEntry(TieredJIT* jit, uint64_t index)
+    {
+        jit->requestTierUp(index);
+    }
+
+    void TieredJIT::requestTierUp(uint64_t index)
+    {
+        ++tierUpRequests;
+        {
+            std::lock_guard lock(queueMutex);
+            if (stopping) return;
+            functions[index]->requestedAt = std::chrono::steady_clock::now();
+            queue.push_back(index);
+            ++pending;
+        }
+        queueCondition.notify_one();
+    }
+
+    // The tier-1 module is rebuilt from the bitcode in its own context. Only the hot function keeps a real
+    // definition (as F.tier1); other functions stay available_externally so they can be inlined, and globals
+    // resolve to the tier-0 definitions so state is shared between tiers.
+    void TieredJIT::compileTier1(uint64_t index)
+    {
+        const auto& name = functions[index]->name;
+        llvm::LLVMContext context;
+        auto module = check(llvm::parseBitcodeFile(
+            llvm::MemoryBufferRef(llvm::StringRef(bitcode.data(), bitcode.size()), name + ".tier1"), context));
+        if (auto* constructors = module->getGlobalVariable("llvm.global_ctors")) constructors->eraseFromParent();
+        if (auto* destructors = module->getGlobalVariable("llvm.global_dtors")) destructors->eraseFromParent();
+        for (auto& global : module->globals())
+        {
+            if (global.isDeclaration()) continue;
+            if (global.isConstant())
+            {
+                global.setLinkage(llvm::GlobalValue::AvailableExternallyLinkage);
+            }
+            else
+            {
+                global.setInitializer(nullptr);
+                global.setLinkage(llvm::GlobalValue::ExternalLinkage);
+            }
+        }
+        auto* hot = module->getFunction(name);
+        if (hot == nullptr || hot->isDeclaration()) throw std::runtime_error("No body for " + name);
+        for (auto& function : *module)
+            if (!function.isDeclaration() && &function != hot)
+                function.setLinkage(llvm::GlobalValue::AvailableExternallyLinkage);
+        hot->setName(name + ".tier1");
+
+        CompileOptions compileOptions;
+        compileOptions.triple = triple;
+        compileOptions.optLevel = options.tier1OptLevel;
+        const auto targetMachine = createTargetMachine(triple, cpu, features, options.tier1OptLevel);
+        optimize(module.get(), targetMachine.get(), compileOptions);
+        llvm::SmallVector<char, 0> object;
+        emitObject(module.get(), targetMachine.get(), object);
+
+        check(jit->addObjectFile(llvm::MemoryBuffer::getMemBufferCopy(
+            llvm::StringRef(object.data(), object.size()), name + ".tier1")));
+        check(stubsManager->updatePointer(name, check(jit->lookup(name + ".tier1"))));
+    }
+
+    void TieredJIT::runWorker()
+    {
+        while (true)
+        {
+            uint64_t index;
+            {
+                std::unique_lock lock(queueMutex);
+                queueCondition.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (stopping)
+                {
+                    // Requests still queued are dropped, so anyone waiting for them has to be released here.
+                    pending -= queue.size();
+                    queue.clear();
+                    idleCondition.notify_all();
+                    return;
+                }
+                index = queue.front();
+                queue.pop_front();
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            try
+            {
+                compileTier1(index);
+                functions[index]->tier = 1;
+                ++tieredUp;
+            }
+            catch (const std::exception& e)
+            {
+                ++failed;
+                llvm::WithColor::warning() << "tier-up of " << functions[index]->name << " failed: " << e.what()
+                    << "\n";
+            }
+            const auto end = std::chrono::steady_clock::now();
+            tier1CompileMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+            {
+                std::lock_guard lock(queueMutex);
+                functions[index]->tierUpLatency = std::chrono::duration_cast<std::chrono::microseconds>(
+                    end - functions[index]->requestedAt);
+                --pending;
+            }
+            idleCondition.notify_all();
+        }
+    }
+
+    llvm::orc::ExecutorAddr TieredJIT::lookup(const std::string& name)
+    {
+        return check(jit->lookup(name));
+    }
+
+    void TieredJIT::waitForPendingCompiles()
+    {
+        std::unique_lock lock(queueMutex);
+        idleCondition.wait(lock, [this] { return pending == 0; });
+    }
+
+    TierUpStatistics TieredJIT::statistics() const
+    {
+        TierUpStatistics result;
+        result.tier0Functions = functions.size();
+        result.tierUpRequests = tierUpRequests;
+        result.tieredUp = tieredUp;
+        result.failed = failed;
+        result.tier1CompileTime = std::chrono::microseconds(tier1CompileMicroseconds);
+        std::lock_guard lock(queueMutex);
+        for (const auto& function : functions)
+            result.functions.push_back({function->name, function->tier, function->tierUpLatency});
+        return result;
+    }
+}
@@ -0,0 +1,135 @@
+#include "test_util.h"
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/TargetParser/Triple.h>
+
+#include <algorithm>
+#include <ranges>
+
+// Builds a target_clones kernel and a driver that calls it through the ifunc and then every clone directly,
+// skipping clones whose features the host lacks, and checks that all of them compute the same value.
+
+namespace
+{
+    const std::string KERNEL = R"(function i64 kernel(i64 n){}{
+entry:
+	%n = load localref n
+	%i = stack_alloc i64
+	%acc = stack_alloc i64
+	store i64* %i, i64 0
+	store i64* %acc, i64 0
+	goto label loop
+loop:
+	%iv = load i64* %i
+	%a = load i64* %acc
+	%sq = mul i64 %iv, i64 %iv
+	%sh = shr i64 %iv, i64 3
+	%x = xor i64 %sq, i64 %sh
+	%s = add i64 %a, i64 %x
+	store i64* %acc, i64 %s
+	%next = add i64 %iv, i64 1
+	store i64* %i, i64 %next
+	conditional_jump l, i64 %next, i64 %n, label loop
+done:
+	%r = load i64* %acc
+	return i64 %r
+}
+)";
+
+    constexpr int64_t ITERATIONS = 100000;
+
+    const std::vector<std::vector<std::string>> FEATURE_SETS = {{"avx512f", "avx512bw"}, {"avx2", "fma"}, {"sse4.2"}};
+
+    uint64_t expectedResult()
+    {
+        uint64_t result = 0;
+        for (uint64_t i = 0; i < ITERATIONS; ++i) result += (i * i) ^ (i >> 3);
+        return result;
+    }
+
+    // main(argc) prints "<label> <kernel(argc * ITERATIONS)>" for every callee; argc keeps the optimizer from
+    // folding the kernel away.
+    void emitDriver(llvm::Module* module, const std::vector<std::pair<std::string, llvm::Constant*>>& callees)
+    {
+        auto& context = module->getContext();
+        llvm::IRBuilder<> builder(context);
+        auto* int64Type = builder.getInt64Ty();
+        auto* kernelType = llvm::FunctionType::get(int64Type, {int64Type}, false);
+        const auto printfFunction = module->getOrInsertFunction(
+            "printf", llvm::FunctionType::get(builder.getInt32Ty(), {builder.getPtrTy()}, true));
+        auto* main = llvm::Function::Create(
+            llvm::FunctionType::get(builder.getInt32Ty(), {builder.getInt32Ty(), builder.getPtrTy()}, false),
+            llvm::GlobalValue::ExternalLinkage, "main", module);
+        builder.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", main));
+        auto* count = builder.CreateMul(builder.CreateZExt(main->getArg(0), int64Type),
+                                        builder.getInt64(ITERATIONS));
+        auto* format = builder.CreateGlobalString("%s %llu\n");
+        for (const auto& [label, callee] : callees)
+        {
+            auto* value = builder.CreateCall(kernelType, callee, {count});
+            builder.CreateCall(printfFunction, {format, builder.CreateGlobalString(label), value});
+        }
+        builder.CreateRet(builder.getInt32(0));
+    }
+}
+
+int main()
+{
+    return lg::llvm_ir_gen::test::runTest("multiversion_test", []
+    {
+        using namespace lg::llvm_ir_gen;
+        if (!llvm::Triple(llvm::sys::getDefaultTargetTriple()).isX86())
+        {
+            llvm::outs() << "multiversion_test: skipped, target_clones needs an x86 host\n";
+            return;
+        }
+        const test::WorkDirectory work;
+        const auto options = test::hostCompileOptions(2);
+
+        std::vector<std::string> targetClones;
+        for (const auto& features : FEATURE_SETS) targetClones.push_back(llvm::join(features, "+"));
+        auto* irModule = lg::ir::parser::parse(KERNEL);
+        for (auto* function : irModule->functions | std::views::values)
+            if (function->name == "kernel")
+                function->attributes.push_back("target_clones(" + llvm::join(targetClones, ", ") + ")");
+
+        llvm::LLVMContext context;
+        llvm::Module module("multiversion", context);
+        configureModule(&module, options);
+        LLVMIRGenerator generator(irModule, &context, &module);
+        generator.generate();
+
+        // Calling a clone directly on a CPU without its features would fault, so those are left out.
+        const auto hostFeatures = llvm::sys::getHostCPUFeatures();
+        std::vector<std::pair<std::string, llvm::Constant*>> callees = {{"ifunc", module.getNamedIFunc("kernel")}};
+        for (const auto& features : FEATURE_SETS)
+        {
+            const auto supported = [&](const std::string& feature) { return hostFeatures.lookup(feature); };
+            if (!std::ranges::all_of(features, supported)) continue;
+            const auto name = "kernel." + llvm::join(features, "_");
+            auto* clone = module.getFunction(name);
+            test::check(clone != nullptr, "no clone named " + name);
+            test::check(clone->getFnAttribute("target-features").getValueAsString().contains("+" + features.front()),
+                        name + " is not built with its features");
+            callees.emplace_back(name, clone);
+        }
+        callees.emplace_back("kernel.default", module.getFunction("kernel.default"));
+        test::check(callees.front().second != nullptr && callees.back().second != nullptr,
+                    "kernel was not turned into an ifunc over a default variant");
+        emitDriver(&module, callees);
+        compile(&module, options, work.file("multiversion"));
+
+        const auto output = test::runChecked(work.file("multiversion"));
+        llvm::SmallVector<llvm::StringRef> lines;
+        llvm::StringRef(output).split(lines, '\n', -1, false);
+        test::check(lines.size() == callees.size(), "expected one line per variant, got:\n" + output);
+        const auto expected = std::to_string(expectedResult());
+        for (size_t i = 0; i < lines.size(); ++i)
+        {
+            const auto [label, value] = lines[i].split(' ');
+            test::check(label == callees[i].first && value == expected,
+                        lines[i].str() + " does not match the expected " + callees[i].first + " " + expected);
+        }
+    });
+}
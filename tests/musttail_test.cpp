@@ -0,0 +1,106 @@
+#include "test_util.h"
+
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Instructions.h>
+
+#include <ranges>
+
+// Mutually recursive fastcc handlers that call each other through musttail must run in constant stack: a
+// recursion depth whose frames would need gigabytes of stack has to complete. The same program is built at
+// -O0, where only musttail guarantees the calls become jumps, and at -O2.
+
+namespace
+{
+    const std::string PROGRAM = R"(extern function i32 printf(u8* fmt, ...)
+global fmt = string "%d\n"
+function i32 is_even(i32 n){}{
+entry:
+	%n = load localref n
+	conditional_jump e, i32 %n, i32 0, label zero
+step:
+	%m = sub i32 %n, i32 1
+	%r = invoke i32 funcref is_odd(i32 %m)
+	return i32 %r
+zero:
+	return i32 1
+}
+function i32 is_odd(i32 n){}{
+entry:
+	%n = load localref n
+	conditional_jump e, i32 %n, i32 0, label zero
+step:
+	%m = sub i32 %n, i32 1
+	%r = invoke i32 funcref is_even(i32 %m)
+	return i32 %r
+zero:
+	return i32 0
+}
+function i32 main(){}{
+entry:
+	%r = invoke i32 funcref is_even(i32 100000000)
+	%f = getelementptr globalref fmt, i32 0, i32 0
+	%p = invoke i32 funcref printf(u8* %f, i32 %r)
+	return i32 0
+}
+)";
+
+    const std::pair<const char*, const char*> HANDLERS[] = {{"is_even", "is_odd"}, {"is_odd", "is_even"}};
+
+    lg::ir::IRModule* parseProgram()
+    {
+        auto* module = lg::ir::parser::parse(PROGRAM);
+        for (auto* function : module->functions | std::views::values)
+        {
+            for (const auto& [name, callee] : HANDLERS)
+            {
+                if (function->name != name) continue;
+                function->attributes.emplace_back("fastcc");
+                function->attributes.push_back(std::string("musttail(") + callee + ")");
+            }
+        }
+        return module;
+    }
+}
+
+int main()
+{
+    return lg::llvm_ir_gen::test::runTest("musttail_test", []
+    {
+        using namespace lg::llvm_ir_gen;
+        const test::WorkDirectory work;
+        for (const unsigned optLevel : {0u, 2u})
+        {
+            const auto options = test::hostCompileOptions(optLevel);
+            llvm::LLVMContext context;
+            llvm::Module module("musttail", context);
+            configureModule(&module, options);
+            LLVMIRGenerator generator(parseProgram(), &context, &module);
+            generator.generate();
+
+            for (const auto& [name, callee] : HANDLERS)
+            {
+                const auto* function = module.getFunction(name);
+                test::check(function->getCallingConv() == llvm::CallingConv::Fast,
+                            std::string(name) + " is not fastcc");
+                bool found = false;
+                for (const auto& instruction : llvm::instructions(*function))
+                {
+                    const auto* call = llvm::dyn_cast<llvm::CallInst>(&instruction);
+                    if (call == nullptr || call->getCalledFunction() != module.getFunction(callee)) continue;
+                    test::check(call->isMustTailCall() && call->getCallingConv() == llvm::CallingConv::Fast,
+                                std::string("the call from ") + name + " to " + callee + " is not a fastcc musttail");
+                    found = true;
+                }
+                test::check(found, std::string(name) + " does not call " + callee);
+            }
+
+            // 10^8 frames of even the smallest size would far exceed any default stack limit.
+            const auto binary = work.file("musttail.O" + std::to_string(optLevel));
+            compile(&module, options, binary);
+            const auto result = test::run(binary);
+            test::check(result.status == 0, "the -O" + std::to_string(optLevel) + " build exited with status " +
+                        std::to_string(result.status) + ", the recursion did not run in constant stack");
+            test::check(result.output == "1\n", "is_even(100000000) printed " + result.output);
+        }
+    });
+}
@@ -0,0 +1,105 @@
+#include "test_util.h"
+
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/ProfDataUtils.h>
+
+#include <algorithm>
+
+// Builds a program with a skewed branch instrumented, trains it, merges the profile with llvm-profdata and
+// rebuilds with the profile, checking that the optimizer saw the counts and that behaviour is unchanged.
+
+namespace
+{
+    const std::string PROGRAM = R"(extern function i32 printf(u8* fmt, ...)
+global fmt = string "%d\n"
+function i32 classify(i32 n){}{
+entry:
+	%n = load localref n
+	%m = mod i32 %n, i32 100
+	conditional_jump e, i32 %m, i32 0, label rare
+common:
+	%c = add i32 %n, i32 1
+	return i32 %c
+rare:
+	%r = mul i32 %n, i32 3
+	return i32 %r
+}
+function i32 main(){}{
+entry:
+	%i = stack_alloc i32
+	%acc = stack_alloc i32
+	store i32* %i, i32 0
+	store i32* %acc, i32 0
+	goto label loop
+loop:
+	%iv = load i32* %i
+	%v = invoke i32 funcref classify(i32 %iv)
+	%a = load i32* %acc
+	%s = add i32 %a, i32 %v
+	store i32* %acc, i32 %s
+	%next = add i32 %iv, i32 1
+	store i32* %i, i32 %next
+	conditional_jump l, i32 %next, i32 100000, label loop
+done:
+	%r = load i32* %acc
+	%f = getelementptr globalref fmt, i32 0, i32 0
+	%p = invoke i32 funcref printf(u8* %f, i32 %r)
+	return i32 0
+}
+)";
+
+    // The largest ratio between the weights of one branch, over every branch carrying profile weights.
+    double largestBranchSkew(const llvm::Module& module)
+    {
+        double skew = 0;
+        for (const auto& function : module)
+        {
+            for (const auto& block : function)
+            {
+                const auto* branch = llvm::dyn_cast<llvm::BranchInst>(block.getTerminator());
+                if (branch == nullptr || !branch->isConditional()) continue;
+                llvm::SmallVector<uint32_t> weights;
+                if (!llvm::extractBranchWeights(*branch, weights) || weights.size() != 2) continue;
+                const auto [low, high] = std::minmax(weights[0], weights[1]);
+                skew = std::max(skew, static_cast<double>(high) / std::max(low, 1u));
+            }
+        }
+        return skew;
+    }
+}
+
+int main()
+{
+    return lg::llvm_ir_gen::test::runTest("pgo_test", []
+    {
+        using namespace lg::llvm_ir_gen;
+        const test::WorkDirectory work;
+        const auto profraw = work.file("train.profraw");
+        const auto profdata = work.file("train.profdata");
+
+        auto options = test::hostCompileOptions(2);
+        options.pgo = PGOMode::INSTRUMENT;
+        options.profilePath = profraw;
+        test::build(PROGRAM, options, work.file("instrumented"));
+        const auto trainedOutput = test::runChecked(work.file("instrumented"));
+        test::check(llvm::sys::fs::exists(profraw), "the instrumented binary wrote no " + profraw);
+
+        const auto merge = test::run(LG_TEST_LLVM_PROFDATA, {"merge", "-o", profdata, profraw});
+        test::check(merge.status == 0, "llvm-profdata merge failed");
+
+        // The use build is optimized in process so the annotated module can be inspected before emission.
+        options.pgo = PGOMode::USE;
+        options.profilePath = profdata;
+        llvm::LLVMContext context;
+        const auto module = test::generate(context, PROGRAM, options);
+        const auto targetMachine = prepareModule(module.get(), options);
+        optimize(module.get(), targetMachine.get(), options);
+        const auto entryCount = module->getFunction("main")->getEntryCount();
+        test::check(entryCount && entryCount->getCount() == 1, "main carries no profile entry count");
+        test::check(largestBranchSkew(*module) >= 10, "no branch carries the trained, skewed weights");
+
+        test::build(PROGRAM, options, work.file("optimized"));
+        test::check(test::runChecked(work.file("optimized")) == trainedOutput,
+                    "the profile-optimized binary prints a different result");
+    });
+}
@@ -0,0 +1,142 @@
+#ifndef LG_LLVM_IR_GENERATOR_CPP_TEST_UTIL_H
+#define LG_LLVM_IR_GENERATOR_CPP_TEST_UTIL_H
+#include <lg/parser.h>
+
+#include "codegen.h"
+#include "llvm_ir_gen.h"
+
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/TargetParser/Host.h>
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Helpers shared by the end-to-end tests. Each test is its own executable that builds lg programs, runs them
+// and throws std::runtime_error on the first failed check.
+namespace lg::llvm_ir_gen::test
+{
+    inline void check(bool condition, const std::string& message)
+    {
+        if (!condition) throw std::runtime_error(message);
+    }
+
+    // A scratch directory removed with everything in it when the test ends.
+    class WorkDirectory
+    {
+    private:
+        llvm::SmallString<128> path;
+
+    public:
+        WorkDirectory()
+        {
+            if (const auto error = llvm::sys::fs::createUniqueDirectory("lg-test", path))
+                throw std::runtime_error("Failed to create a work directory: " + error.message());
+        }
+
+        ~WorkDirectory()
+        {
+            llvm::sys::fs::remove_directories(path);
+        }
+
+        WorkDirectory(const WorkDirectory&) = delete;
+        WorkDirectory& operator=(const WorkDirectory&) = delete;
+
+        std::string file(const std::string& name) const
+        {
+            llvm::SmallString<128> result(path);
+            llvm::sys::path::append(result, name);
+            return result.str().str();
+        }
+    };
+
+    inline CompileOptions hostCompileOptions(unsigned optLevel = 0)
+    {
+        CompileOptions options;
+        options.triple = llvm::sys::getDefaultTargetTriple();
+        options.optLevel = optLevel;
+        return options;
+    }
+
+    // Parses code and lowers it into a fresh module configured for options.
+    inline std::unique_ptr<llvm::Module> generate(llvm::LLVMContext& context, const std::string& code,
+                                                  const CompileOptions& options,
+                                                  GeneratorOptions generatorOptions = {})
+    {
+        auto module = std::make_unique<llvm::Module>("test", context);
+        configureModule(module.get(), options);
+        LLVMIRGenerator generator(ir::parser::parse(code), &context, module.get(), std::move(generatorOptions));
+        generator.generate();
+        return module;
+    }
+
+    inline void build(const std::string& code, const CompileOptions& options, const std::string& output,
+                      GeneratorOptions generatorOptions = {})
+    {
+        llvm::LLVMContext context;
+        const auto module = generate(context, code, options, std::move(generatorOptions));
+        compile(module.get(), options, output);
+    }
+
+    struct RunResult
+    {
+        int status;
+        std::string output;
+    };
+
+    // Runs program with args and returns its exit status and standard output. An empty environment keeps the
+    // caller's.
+    inline RunResult run(const std::string& program, const std::vector<std::string>& args = {},
+                         const std::vector<std::string>& environment = {})
+    {
+        llvm::SmallString<128> outputPath;
+        if (const auto error = llvm::sys::fs::createTemporaryFile("lg-test", "out", outputPath))
+            throw std::runtime_error("Failed to create temporary file: " + error.message());
+        std::vector<llvm::StringRef> argv = {program};
+        for (const auto& arg : args) argv.emplace_back(arg);
+        const std::vector<llvm::StringRef> env(environment.begin(), environment.end());
+        const std::optional<llvm::StringRef> redirects[] = {std::nullopt, outputPath.str(), std::nullopt};
+        std::string error;
+        const auto status = llvm::sys::ExecuteAndWait(
+            program, argv, environment.empty() ? std::nullopt : std::optional<llvm::ArrayRef<llvm::StringRef>>(env),
+            redirects, 0, 0, &error);
+        if (status < 0) throw std::runtime_error("Failed to run " + program + ": " + error);
+        auto buffer = llvm::MemoryBuffer::getFile(outputPath);
+        llvm::sys::fs::remove(outputPath);
+        if (!buffer) throw std::runtime_error("Failed to read the output of " + program);
+        return {status, (*buffer)->getBuffer().str()};
+    }
+
+    // Runs program and checks that it exits successfully, returning its standard output.
+    inline std::string runChecked(const std::string& program, const std::vector<std::string>& args = {},
+                                  const std::vector<std::string>& environment = {})
+    {
+        auto result = run(program, args, environment);
+        check(result.status == 0, program + " exited with status " + std::to_string(result.status));
+        return result.output;
+    }
+
+    inline int runTest(const char* name, const std::function<void()>& body)
+    {
+        try
+        {
+            body();
+            llvm::outs() << name << ": passed\n";
+            return 0;
+        }
+        catch (const std::exception& e)
+        {
+            llvm::errs() << name << ": " << e.what() << "\n";
+            return 1;
+        }
+    }
+}
+
+#endif //LG_LLVM_IR_GENERATOR_CPP_TEST_UTIL_H
@@ -0,0 +1,87 @@
+#include "test_util.h"
+#include "tiered_jit.h"
+
+// Runs a function through the tiered JIT up to one call short of the threshold, checks that nothing was queued,
+// then crosses it, waits for the tier-1 compile and checks that the stub still returns the right result.
+// A second JIT is destroyed with a tier-up still queued to make sure waiting and shutdown do not hang.
+
+namespace
+{
+    const std::string PROGRAM = R"(function i64 mix(i64 n){}{
+entry:
+	%n = load localref n
+	%i = stack_alloc i64
+	%acc = stack_alloc i64
+	store i64* %i, i64 0
+	store i64* %acc, i64 0
+	goto label loop
+loop:
+	%iv = load i64* %i
+	%a = load i64* %acc
+	%sq = mul i64 %iv, i64 %iv
+	%x = xor i64 %sq, i64 %n
+	%s = add i64 %a, i64 %x
+	store i64* %acc, i64 %s
+	%next = add i64 %iv, i64 1
+	store i64* %i, i64 %next
+	conditional_jump l, i64 %next, i64 1000, label loop
+done:
+	%r = load i64* %acc
+	return i64 %r
+}
+)";
+
+    constexpr uint64_t THRESHOLD = 50;
+
+    int64_t expectedMix(int64_t n)
+    {
+        uint64_t result = 0;
+        for (uint64_t i = 0; i < 1000; ++i) result += (i * i) ^ static_cast<uint64_t>(n);
+        return static_cast<int64_t>(result);
+    }
+
+    std::unique_ptr<lg::llvm_ir_gen::TieredJIT> createJIT(uint64_t threshold)
+    {
+        using namespace lg::llvm_ir_gen;
+        auto context = std::make_unique<llvm::LLVMContext>();
+        auto module = test::generate(*context, PROGRAM, test::hostCompileOptions());
+        TieredJITOptions options;
+        options.tierUpThreshold = threshold;
+        return std::make_unique<TieredJIT>(std::move(context), std::move(module), options);
+    }
+}
+
+int main()
+{
+    return lg::llvm_ir_gen::test::runTest("tiered_jit_test", []
+    {
+        using namespace lg::llvm_ir_gen;
+        {
+            const auto jit = createJIT(THRESHOLD);
+            auto* mix = jit->lookupFunction<int64_t(int64_t)>("mix");
+            for (uint64_t i = 0; i + 1 < THRESHOLD; ++i)
+                test::check(mix(static_cast<int64_t>(i)) == expectedMix(static_cast<int64_t>(i)),
+                            "tier 0 returned a wrong result for " + std::to_string(i));
+            test::check(jit->statistics().tierUpRequests == 0, "mix was queued before reaching the threshold");
+
+            test::check(mix(7) == expectedMix(7), "the call crossing the threshold returned a wrong result");
+            jit->waitForPendingCompiles();
+            const auto statistics = jit->statistics();
+            test::check(statistics.tierUpRequests == 1, "crossing the threshold did not queue exactly one tier-up");
+            test::check(statistics.tieredUp == 1 && statistics.failed == 0, "mix was not recompiled at tier 1");
+            test::check(statistics.functions.size() == 1 && statistics.functions.front().tier == 1,
+                        "mix is not reported at tier 1");
+
+            // The same stub address now forwards to the tier-1 body.
+            for (const int64_t n : {0, 7, -3, 123456789})
+                test::check(mix(n) == expectedMix(n), "tier 1 returned a wrong result for " + std::to_string(n));
+            test::check(jit->statistics().tierUpRequests == 1, "mix was queued again after tiering up");
+        }
+        {
+            // Destroying the JIT while a tier-up may still be queued must neither hang nor crash.
+            const auto jit = createJIT(1);
+            test::check(jit->lookupFunction<int64_t(int64_t)>("mix")(1) == expectedMix(1),
+                        "tier 0 returned a wrong result");
+        }
+    });
+}